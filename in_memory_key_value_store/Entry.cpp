@@ -0,0 +1,95 @@
+#include "bits/stdc++.h"
+#include "SlabAllocator.cpp"
+#include "TimingWheel.cpp"
+
+using namespace std;
+
+#pragma once
+
+using TimePoint = chrono::steady_clock::time_point;
+using Duration = chrono::steady_clock::duration;
+
+// Heap-stable so the shard's wheel can link it directly and the index can key
+// on a string_view into it; the key is stored exactly once. key and value
+// never change once the entry is published: set() swaps in a new entry and
+// retires the old one, so lock-free readers always see a consistent one.
+// Only the atomics change in place, under the shard lock: expiry (touch),
+// and counter and version (incr).
+//
+// An entry is a single slab block: the struct followed by the key and value
+// bytes, which key and value view.
+struct Entry : TimerNode
+{
+    string_view key;
+    string_view value;
+    atomic<TimePoint> expiry;
+
+    // Changes with every write to the key, including in-place increments
+    atomic<uint64_t> version{0};
+
+    // Counters keep their value here, with an empty value string
+    bool numeric = false;
+    atomic<int64_t> counter{0};
+
+    // Set by getOrLoad: the tail of the lifetime served as stale, and what
+    // the loader cost, which drives early refresh
+    uint32_t staleMs = 0;
+    uint32_t loadCostUs = 0;
+
+    // Eviction bookkeeping. The atomics are bumped by lock-free readers, the
+    // rest belongs to the shard's policy under the shard lock.
+    atomic<uint32_t> lastAccess{0};
+    atomic<uint8_t> frequency{0};
+    uint8_t region = 0;
+    uint32_t poolIndex = 0;
+
+    static Entry *create(SlabAllocator &slab, string_view key, string_view value, TimePoint expiry)
+    {
+        Entry *entry = new (slab.allocate(sizeof(Entry) + key.size() + value.size())) Entry();
+        char *data = reinterpret_cast<char *>(entry + 1);
+        memcpy(data, key.data(), key.size());
+        memcpy(data + key.size(), value.data(), value.size());
+        entry->key = string_view(data, key.size());
+        entry->value = string_view(data + key.size(), value.size());
+        entry->expiry.store(expiry, memory_order_relaxed);
+        return entry;
+    }
+
+    static Entry *createCounter(SlabAllocator &slab, string_view key, int64_t value, TimePoint expiry)
+    {
+        Entry *entry = create(slab, key, "", expiry);
+        entry->numeric = true;
+        entry->counter.store(value, memory_order_relaxed);
+        return entry;
+    }
+
+    // The value as text; counters are formatted into buf
+    string_view text(char (&buf)[24]) const
+    {
+        if (!numeric)
+            return value;
+        int n = snprintf(buf, sizeof(buf), "%" PRId64, counter.load(memory_order_relaxed));
+        return string_view(buf, n);
+    }
+
+    // Type-erased so it can be handed to EpochDomain::retire
+    static void destroy(void *ptr)
+    {
+        Entry *entry = static_cast<Entry *>(ptr);
+        size_t bytes = sizeof(Entry) + entry->key.size() + entry->value.size();
+        entry->~Entry();
+        SlabAllocator::deallocate(ptr, bytes);
+    }
+
+    // Approximate bytes charged against the store's budget
+    static size_t footprint(size_t keySize, size_t valueSize)
+    {
+        // Entry with its inline payload, and an index slot plus control byte
+        return sizeof(Entry) + keySize + valueSize + sizeof(Entry *) + 1;
+    }
+
+    size_t footprint() const
+    {
+        return footprint(key.size(), value.size());
+    }
+};
@@ -0,0 +1,357 @@
+#include "bits/stdc++.h"
+#include "Entry.cpp"
+
+using namespace std;
+
+#pragma once
+
+enum EvictionPolicyType
+{
+    LRU = 0,
+    SAMPLED_LFU = 1,
+    W_TINY_LFU = 2
+};
+
+// Millisecond clock folded to 32 bits; only differences are ever compared
+static uint32_t coarseNowMs()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One instance per shard. onAccess runs on the lock-free read path and may
+// only touch atomics; everything else is called under the shard lock.
+class EvictionPolicy
+{
+public:
+    virtual void onInsert(Entry *entry) = 0;
+    virtual void onRemove(Entry *entry) = 0;
+    virtual void onAccess(Entry *entry) = 0;
+
+    // Next entry to evict, or nullptr when the policy tracks nothing
+    virtual Entry *victim() = 0;
+
+    virtual ~EvictionPolicy() = default;
+
+    static unique_ptr<EvictionPolicy> create(EvictionPolicyType type, size_t budgetBytes);
+};
+
+// Dense array of entries for O(1) add/remove and random sampling, the way
+// Redis approximates LRU/LFU without a list update on every read
+class SampledPool
+{
+private:
+    static constexpr int SAMPLES = 5;
+
+    vector<Entry *> entries;
+    mt19937 rng{random_device{}()};
+
+public:
+    void add(Entry *entry)
+    {
+        entry->poolIndex = entries.size();
+        entries.push_back(entry);
+    }
+
+    void remove(Entry *entry)
+    {
+        Entry *last = entries.back();
+        entries[entry->poolIndex] = last;
+        last->poolIndex = entry->poolIndex;
+        entries.pop_back();
+    }
+
+    // Lowest-scoring of a few random entries
+    template <typename Score>
+    Entry *sample(Score score)
+    {
+        if (entries.empty())
+            return nullptr;
+
+        Entry *best = nullptr;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            Entry *candidate = entries[rng() % entries.size()];
+            if (!best || score(candidate) < score(best))
+                best = candidate;
+        }
+        return best;
+    }
+
+    bool empty() const
+    {
+        return entries.empty();
+    }
+};
+
+static int64_t idleMs(const Entry *entry)
+{
+    return int32_t(coarseNowMs() - entry->lastAccess.load(memory_order_relaxed));
+}
+
+static void touch(Entry *entry)
+{
+    uint32_t now = coarseNowMs();
+    // Skip the store when nothing changed to keep the cache line shared
+    if (entry->lastAccess.load(memory_order_relaxed) != now)
+        entry->lastAccess.store(now, memory_order_relaxed);
+}
+
+class LruPolicy : public EvictionPolicy
+{
+private:
+    SampledPool pool;
+
+public:
+    void onInsert(Entry *entry) override
+    {
+        touch(entry);
+        pool.add(entry);
+    }
+
+    void onRemove(Entry *entry) override
+    {
+        pool.remove(entry);
+    }
+
+    void onAccess(Entry *entry) override
+    {
+        touch(entry);
+    }
+
+    Entry *victim() override
+    {
+        return pool.sample([](const Entry *e)
+                           { return -idleMs(e); });
+    }
+};
+
+// Redis-style logarithmic 8-bit counter that decays while the key sits idle
+class SampledLfuPolicy : public EvictionPolicy
+{
+private:
+    static constexpr int INITIAL = 5;
+    static constexpr int LOG_FACTOR = 10;
+    static constexpr int64_t DECAY_MS = 60000;
+
+    SampledPool pool;
+
+    static int decayed(const Entry *entry)
+    {
+        int64_t periods = idleMs(entry) / DECAY_MS;
+        int counter = entry->frequency.load(memory_order_relaxed);
+        return periods > counter ? 0 : counter - periods;
+    }
+
+public:
+    void onInsert(Entry *entry) override
+    {
+        entry->frequency.store(INITIAL, memory_order_relaxed);
+        touch(entry);
+        pool.add(entry);
+    }
+
+    void onRemove(Entry *entry) override
+    {
+        pool.remove(entry);
+    }
+
+    void onAccess(Entry *entry) override
+    {
+        int counter = decayed(entry);
+        if (counter < 255)
+        {
+            static thread_local minstd_rand rng(random_device{}());
+            double p = 1.0 / ((max(counter - INITIAL, 0)) * LOG_FACTOR + 1);
+            if (uniform_real_distribution<double>(0, 1)(rng) < p)
+                counter++;
+        }
+        entry->frequency.store(counter, memory_order_relaxed);
+        touch(entry);
+    }
+
+    Entry *victim() override
+    {
+        return pool.sample([](const Entry *e)
+                           { return make_pair(decayed(e), -idleMs(e)); });
+    }
+};
+
+// 4-row count-min sketch of 4-bit-range counters, halved periodically so old
+// popularity fades. Increments are relaxed atomics and may race with a reset;
+// the sketch only needs to be approximately right.
+class FrequencySketch
+{
+private:
+    static constexpr int ROWS = 4;
+    static constexpr uint8_t MAX_COUNT = 15;
+
+    vector<atomic<uint8_t>> counters;
+    size_t mask;
+    atomic<size_t> additions{0};
+    size_t resetAt;
+
+    size_t index(uint64_t hash, int row) const
+    {
+        uint64_t h = (hash + row) * 0x9E3779B97F4A7C15ull;
+        return (row * (mask + 1)) + ((h ^ (h >> 29)) & mask);
+    }
+
+public:
+    FrequencySketch(size_t width)
+    {
+        size_t w = 1024;
+        while (w < width)
+            w *= 2;
+        mask = w - 1;
+        counters = vector<atomic<uint8_t>>(w * ROWS);
+        resetAt = w * 10;
+    }
+
+    void increment(uint64_t hash)
+    {
+        for (int row = 0; row < ROWS; row++)
+        {
+            auto &counter = counters[index(hash, row)];
+            uint8_t value = counter.load(memory_order_relaxed);
+            if (value < MAX_COUNT)
+                counter.store(value + 1, memory_order_relaxed);
+        }
+        additions.fetch_add(1, memory_order_relaxed);
+    }
+
+    int estimate(uint64_t hash) const
+    {
+        int result = MAX_COUNT;
+        for (int row = 0; row < ROWS; row++)
+            result = min<int>(result, counters[index(hash, row)].load(memory_order_relaxed));
+        return result;
+    }
+
+    // Called by the writer; ages every counter once enough samples accrued
+    void maybeReset()
+    {
+        if (additions.load(memory_order_relaxed) < resetAt)
+            return;
+        for (auto &counter : counters)
+            counter.store(counter.load(memory_order_relaxed) / 2, memory_order_relaxed);
+        additions.store(0, memory_order_relaxed);
+    }
+};
+
+// W-TinyLFU: new entries land in a small admission window (1% of the
+// budget). Entries pushed out of the window go straight to the main region
+// while there is room; once the shard is full they become candidates, and on
+// eviction a candidate must beat the main region's sampled LRU victim on
+// sketch frequency to be admitted, otherwise the candidate is evicted.
+class WTinyLfuPolicy : public EvictionPolicy
+{
+private:
+    enum Region : uint8_t
+    {
+        WINDOW = 0,
+        CANDIDATE = 1,
+        MAIN = 2
+    };
+
+    SampledPool window, candidates, mainPool;
+    size_t windowBytes = 0;
+    size_t windowBudget;
+    size_t totalBytes = 0;
+    size_t budget;
+    FrequencySketch sketch;
+    hash<string_view> hasher;
+
+    uint64_t keyHash(const Entry *entry) const
+    {
+        return hasher(entry->key);
+    }
+
+    static Entry *oldest(SampledPool &pool)
+    {
+        return pool.sample([](const Entry *e)
+                           { return -idleMs(e); });
+    }
+
+    SampledPool &poolOf(const Entry *entry)
+    {
+        return entry->region == WINDOW ? window : entry->region == CANDIDATE ? candidates
+                                                                             : mainPool;
+    }
+
+    void move(Entry *entry, Region to)
+    {
+        poolOf(entry).remove(entry);
+        if (entry->region == WINDOW)
+            windowBytes -= entry->footprint();
+        entry->region = to;
+        poolOf(entry).add(entry);
+    }
+
+public:
+    WTinyLfuPolicy(size_t budgetBytes)
+        : windowBudget(max<size_t>(budgetBytes / 100, 1)), budget(budgetBytes), sketch(budgetBytes / 128) {}
+
+    void onInsert(Entry *entry) override
+    {
+        touch(entry);
+        sketch.increment(keyHash(entry));
+        sketch.maybeReset();
+
+        entry->region = WINDOW;
+        window.add(entry);
+        windowBytes += entry->footprint();
+        totalBytes += entry->footprint();
+
+        while (windowBytes > windowBudget && !window.empty())
+            move(oldest(window), totalBytes > budget ? CANDIDATE : MAIN);
+    }
+
+    void onRemove(Entry *entry) override
+    {
+        totalBytes -= entry->footprint();
+        poolOf(entry).remove(entry);
+        if (entry->region == WINDOW)
+            windowBytes -= entry->footprint();
+    }
+
+    void onAccess(Entry *entry) override
+    {
+        touch(entry);
+        sketch.increment(keyHash(entry));
+    }
+
+    Entry *victim() override
+    {
+        while (!candidates.empty())
+        {
+            Entry *candidate = oldest(candidates);
+            Entry *challenged = oldest(mainPool);
+            if (!challenged)
+            {
+                move(candidate, MAIN);
+                continue;
+            }
+            if (sketch.estimate(keyHash(candidate)) <= sketch.estimate(keyHash(challenged)))
+                return candidate;
+
+            move(candidate, MAIN);
+            return challenged;
+        }
+
+        Entry *main = oldest(mainPool);
+        return main ? main : oldest(window);
+    }
+};
+
+unique_ptr<EvictionPolicy> EvictionPolicy::create(EvictionPolicyType type, size_t budgetBytes)
+{
+    switch (type)
+    {
+    case SAMPLED_LFU:
+        return make_unique<SampledLfuPolicy>();
+    case W_TINY_LFU:
+        return make_unique<WTinyLfuPolicy>(budgetBytes);
+    default:
+        return make_unique<LruPolicy>();
+    }
+}
@@ -0,0 +1,327 @@
+#include "bits/stdc++.h"
+#include "Epoch.cpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+#pragma once
+
+// Swiss-table style open addressing: one control byte per slot holding 7 bits
+// of the hash, probed 16 slots at a time. A slot is just the value pointer;
+// keys are read back through it (V must point to something with a `key`
+// member), so slots stay 8 bytes and readers can never observe a torn key.
+//
+// Writers are serialised by the caller. find() is also safe without that lock
+// while the caller holds an EpochGuard: slots and control bytes are published
+// with release stores and a grown table is retired, not freed.
+template <typename K, typename V, typename Hash = hash<K>, typename Eq = equal_to<K>>
+class FlatHashMap
+{
+    static_assert(is_pointer_v<V>, "FlatHashMap stores pointers to keyed objects");
+
+private:
+    static constexpr size_t GROUP = 16;
+
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    // Bit i is set when slot i of the group matches
+    class Group
+    {
+    private:
+#ifdef __SSE2__
+        __m128i ctrl;
+#else
+        int8_t ctrl[GROUP];
+#endif
+
+    public:
+        explicit Group(const int8_t *pos)
+        {
+            // The writer may be storing bytes of the group meanwhile, so it is
+            // read with atomic loads (two words; SSE only does the compares)
+            // and the fence orders the slot loads after them
+#ifdef __SSE2__
+            const uint64_t *words = reinterpret_cast<const uint64_t *>(pos);
+            ctrl = _mm_set_epi64x(__atomic_load_n(words + 1, __ATOMIC_RELAXED), __atomic_load_n(words, __ATOMIC_RELAXED));
+#else
+            for (size_t i = 0; i < GROUP; i++)
+                ctrl[i] = __atomic_load_n(pos + i, __ATOMIC_RELAXED);
+#endif
+            atomic_thread_fence(memory_order_acquire);
+        }
+
+        uint32_t match(int8_t h2) const
+        {
+#ifdef __SSE2__
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+#else
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP; i++)
+                mask |= uint32_t(ctrl[i] == h2) << i;
+            return mask;
+#endif
+        }
+
+        uint32_t matchEmpty() const
+        {
+            return match(EMPTY);
+        }
+
+        uint32_t matchEmptyOrDeleted() const
+        {
+#ifdef __SSE2__
+            return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+#else
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP; i++)
+                mask |= uint32_t(ctrl[i] < -1) << i;
+            return mask;
+#endif
+        }
+    };
+
+    struct alignas(GROUP) CtrlBlock
+    {
+        int8_t bytes[GROUP];
+    };
+
+    struct Table
+    {
+        size_t capacity;
+        unique_ptr<CtrlBlock[]> ctrlBlocks;
+        unique_ptr<V[]> slots;
+
+        Table(size_t capacity)
+            : capacity(capacity), ctrlBlocks(new CtrlBlock[capacity / GROUP]), slots(new V[capacity]())
+        {
+            memset(ctrl(), EMPTY, capacity);
+        }
+
+        int8_t *ctrl()
+        {
+            return ctrlBlocks[0].bytes;
+        }
+
+        size_t groupMask() const
+        {
+            return capacity / GROUP - 1;
+        }
+
+        V load(size_t idx) const
+        {
+            return __atomic_load_n(&slots[idx], __ATOMIC_ACQUIRE);
+        }
+
+        void publish(size_t idx, V value, int8_t h2)
+        {
+            __atomic_store_n(&slots[idx], value, __ATOMIC_RELEASE);
+            __atomic_store_n(&ctrl()[idx], h2, __ATOMIC_RELEASE);
+        }
+    };
+
+    atomic<Table *> table{nullptr};
+    size_t count = 0;
+    size_t deleted = 0;
+
+    Hash hasher;
+    Eq eq;
+
+    size_t hashOf(const K &key) const
+    {
+        // Spread the hash so shard selection (hash % N) and h1/h2 stay independent
+        uint64_t h = hasher(key) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 32);
+    }
+
+    static int8_t h2(size_t hash)
+    {
+        return hash >> 57;
+    }
+
+    // Returns the slot index of key, or capacity if absent. The pointer that
+    // matched is handed back through out, since the slot may change under a
+    // lock-free reader right after the comparison.
+    size_t findIndex(Table *t, const K &key, size_t hash, V *out = nullptr) const
+    {
+        size_t g = hash & t->groupMask();
+        for (size_t step = 1;; step++)
+        {
+            Group group(t->ctrl() + g * GROUP);
+            for (uint32_t mask = group.match(h2(hash)); mask; mask &= mask - 1)
+            {
+                size_t idx = g * GROUP + __builtin_ctz(mask);
+                V value = t->load(idx);
+                if (value && eq(value->key, key))
+                {
+                    if (out)
+                        *out = value;
+                    return idx;
+                }
+            }
+            if (group.matchEmpty())
+                return t->capacity;
+            g = (g + step) & t->groupMask();
+        }
+    }
+
+    static size_t findInsertSlot(Table *t, size_t hash)
+    {
+        size_t g = hash & t->groupMask();
+        for (size_t step = 1;; step++)
+        {
+            uint32_t mask = Group(t->ctrl() + g * GROUP).matchEmptyOrDeleted();
+            if (mask)
+                return g * GROUP + __builtin_ctz(mask);
+            g = (g + step) & t->groupMask();
+        }
+    }
+
+    void rehash(size_t newCapacity)
+    {
+        Table *old = table.load(memory_order_relaxed);
+        Table *fresh = new Table(newCapacity);
+
+        for (size_t i = 0; old && i < old->capacity; i++)
+        {
+            if (old->ctrl()[i] < 0)
+                continue;
+            V value = old->slots[i];
+            size_t hash = hashOf(value->key);
+            fresh->publish(findInsertSlot(fresh, hash), value, h2(hash));
+        }
+
+        table.store(fresh, memory_order_release);
+        deleted = 0;
+        if (old)
+            EpochDomain::global().retire(old);
+    }
+
+    void growIfNeeded()
+    {
+        // Max load factor 7/8, tombstones included
+        size_t capacity = table.load(memory_order_relaxed) ? table.load(memory_order_relaxed)->capacity : 0;
+        if ((count + deleted + 1) * 8 <= capacity * 7)
+            return;
+        if (count * 2 < capacity * 7 / 8 && capacity)
+            rehash(capacity); // mostly tombstones, clean in place
+        else
+            rehash(max<size_t>(capacity * 2, GROUP));
+    }
+
+public:
+    static constexpr bool LOCK_FREE_READS = true;
+
+    FlatHashMap() = default;
+    FlatHashMap(const FlatHashMap &) = delete;
+    FlatHashMap &operator=(const FlatHashMap &) = delete;
+
+    ~FlatHashMap()
+    {
+        delete table.load();
+    }
+
+    // Writers call this under their lock; lock-free readers under an EpochGuard
+    V find(const K &key) const
+    {
+        return find(key, hashOf(key));
+    }
+
+    // For batched lookups that hashed (and prefetched) ahead of time
+    V find(const K &key, size_t hash) const
+    {
+        Table *t = table.load(memory_order_acquire);
+        if (!t)
+            return nullptr;
+        V value = nullptr;
+        findIndex(t, key, hash, &value);
+        return value;
+    }
+
+    size_t hashFor(const K &key) const
+    {
+        return hashOf(key);
+    }
+
+    // Pulls the first probed control group and slots into cache
+    void prefetch(size_t hash) const
+    {
+        Table *t = table.load(memory_order_acquire);
+        if (!t)
+            return;
+        size_t g = hash & t->groupMask();
+        __builtin_prefetch(t->ctrl() + g * GROUP);
+        __builtin_prefetch(&t->slots[g * GROUP]);
+    }
+
+    // Inserts value under value->key, replacing any previous pointer for that key
+    void assign(V value)
+    {
+        size_t hash = hashOf(value->key);
+        Table *t = table.load(memory_order_relaxed);
+        if (t)
+        {
+            size_t idx = findIndex(t, value->key, hash);
+            if (idx != t->capacity)
+            {
+                t->publish(idx, value, h2(hash));
+                return;
+            }
+        }
+
+        growIfNeeded();
+        t = table.load(memory_order_relaxed);
+        size_t idx = findInsertSlot(t, hash);
+        if (t->ctrl()[idx] == DELETED)
+            deleted--;
+        t->publish(idx, value, h2(hash));
+        count++;
+    }
+
+    bool erase(const K &key)
+    {
+        Table *t = table.load(memory_order_relaxed);
+        if (!t)
+            return false;
+        size_t idx = findIndex(t, key, hashOf(key));
+        if (idx == t->capacity)
+            return false;
+
+        // The stale pointer stays in the slot for readers already past the
+        // control byte. A slot in a group that still has an empty byte can
+        // never be on another key's probe path, so it can go back to EMPTY.
+        bool groupHasEmpty = Group(t->ctrl() + idx / GROUP * GROUP).matchEmpty();
+        __atomic_store_n(&t->ctrl()[idx], groupHasEmpty ? EMPTY : DELETED, __ATOMIC_RELEASE);
+        if (!groupHasEmpty)
+            deleted++;
+        count--;
+        return true;
+    }
+
+    void reserve(size_t n)
+    {
+        size_t needed = GROUP;
+        while (needed * 7 / 8 < n)
+            needed *= 2;
+        Table *t = table.load(memory_order_relaxed);
+        if (!t || needed > t->capacity)
+            rehash(needed);
+    }
+
+    template <typename F>
+    void forEach(F f)
+    {
+        Table *t = table.load(memory_order_relaxed);
+        for (size_t i = 0; t && i < t->capacity; i++)
+            if (t->ctrl()[i] >= 0)
+                f(t->slots[i]);
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+};
@@ -0,0 +1,1066 @@
+#include "bits/stdc++.h"
+#include "Entry.cpp"
+#include "EvictionPolicy.cpp"
+#include "FlatHashMap.cpp"
+#include "Persistence.cpp"
+#include "SingleFlight.cpp"
+#include "Stats.cpp"
+
+using namespace std;
+
+#pragma once
+
+#define NA "N/A"
+
+// Strict base-10 int64: no sign-only, whitespace or overflow
+static bool parseInteger(string_view text, int64_t &result)
+{
+    bool negative = !text.empty() && text[0] == '-';
+    if (text.size() == size_t(negative))
+        return false;
+
+    int64_t value = 0;
+    for (size_t i = negative; i < text.size(); i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+            return false;
+        int digit = text[i] - '0';
+        if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, negative ? -digit : digit, &value))
+            return false;
+    }
+    result = value;
+    return true;
+}
+
+// std::map behind the same find/assign/erase surface as FlatHashMap; readers
+// need the shard lock
+template <typename K, typename V>
+class TreeMap
+{
+private:
+    map<K, V> mp;
+
+public:
+    static constexpr bool LOCK_FREE_READS = false;
+
+    V find(const K &key) const
+    {
+        auto it = mp.find(key);
+        return it == mp.end() ? nullptr : it->second;
+    }
+
+    // No hashing or prefetching for a tree; kept for interface parity
+    V find(const K &key, size_t) const
+    {
+        return find(key);
+    }
+
+    size_t hashFor(const K &) const
+    {
+        return 0;
+    }
+
+    void prefetch(size_t) const {}
+
+    void assign(V value)
+    {
+        auto node = mp.extract(value->key);
+        if (node.empty())
+        {
+            mp.emplace(value->key, value);
+            return;
+        }
+        // Re-point the key at the new value's own copy before reinserting
+        node.key() = value->key;
+        node.mapped() = value;
+        mp.insert(std::move(node));
+    }
+
+    bool erase(const K &key)
+    {
+        return mp.erase(key) > 0;
+    }
+
+    void reserve(size_t) {}
+
+    template <typename F>
+    void forEach(F f)
+    {
+        for (auto &[key, value] : mp)
+            f(value);
+    }
+
+    size_t size() const
+    {
+        return mp.size();
+    }
+};
+
+using TreeBackend = TreeMap<string_view, Entry *>;
+using FlatBackend = FlatHashMap<string_view, Entry *>;
+
+template <typename Map>
+class KeyValueStore;
+
+// Zero-copy view of a value. Holding it pins the reclamation epoch, so the
+// bytes stay valid (even across overwrite or expiry) until it is dropped; it
+// must be dropped on the thread that obtained it and should be short-lived.
+class ValueHandle
+{
+private:
+    EpochGuard guard{nullptr};
+    const Entry *entry = nullptr;
+    mutable char digits[24];
+
+    template <typename Map>
+    friend class KeyValueStore;
+
+public:
+    ValueHandle() = default;
+    ValueHandle(EpochGuard guard, const Entry *entry) : guard(std::move(guard)), entry(entry) {}
+
+    explicit operator bool() const
+    {
+        return entry != nullptr;
+    }
+
+    // Counters are formatted on each call, into the handle itself
+    string_view value() const
+    {
+        return entry->text(digits);
+    }
+
+    TimePoint expiry() const
+    {
+        return entry->expiry.load(memory_order_relaxed);
+    }
+
+    uint64_t version() const
+    {
+        return entry->version.load(memory_order_relaxed);
+    }
+};
+
+template <typename Map = FlatBackend>
+class KeyValueStore
+{
+private:
+    // Each shard owns a slice of the key space and is locked independently
+    struct Shard
+    {
+        Map mp;
+        TimingWheel wheel;
+        mutex mtx;
+        uint64_t versions = 0;
+
+        // getOrLoad calls in flight for this shard's keys
+        SingleFlight<string> loads;
+
+        // Entries are allocated from, and retired back into, their shard's slab
+        SlabAllocator *slab = SlabAllocator::create();
+
+        // Null when the store has no byte budget
+        unique_ptr<EvictionPolicy> policy;
+        size_t bytes = 0;
+        size_t budget = 0;
+
+        ~Shard()
+        {
+            mp.forEach([](Entry *entry)
+                       { Entry::destroy(entry); });
+            // Entries still awaiting their grace period keep the slab alive
+            slab->release();
+        }
+    };
+
+    static constexpr Duration::rep NO_EXPIRY = numeric_limits<Duration::rep>::max();
+
+    vector<unique_ptr<Shard>> shards;
+    hash<string_view> hasher;
+
+    // Earliest expiry across all shards, lowered lock-free by setters
+    atomic<Duration::rep> nextCleanup{NO_EXPIRY};
+
+    mutex cleanupMtx;
+    condition_variable cv;
+
+    thread cleanupThread;
+
+    bool stop = false;
+
+    // Null unless enablePersistence() was called
+    unique_ptr<AppendLog> log;
+    bool syncWrites = false;
+    string persistDir;
+    mutex snapshotMtx;
+    condition_variable snapshotCv;
+    thread snapshotThread;
+
+    StatsCollector statsCollector;
+    condition_variable statsCv;
+    thread statsThread;
+
+    // Background reloads for getOrLoad, guarded by cleanupMtx
+    deque<function<void()>> refreshQueue;
+    condition_variable refreshCv;
+    thread refreshThread;
+
+    size_t shardIndex(string_view key) const
+    {
+        return hasher(key) % shards.size();
+    }
+
+    Shard &shardFor(string_view key)
+    {
+        return *shards[shardIndex(key)];
+    }
+
+    // Positions of keys ordered by shard, so a batch visits each shard once
+    template <typename Keys, typename KeyOf>
+    vector<pair<size_t, size_t>> groupByShard(const Keys &keys, KeyOf keyOf) const
+    {
+        vector<pair<size_t, size_t>> order(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            order[i] = {shardIndex(keyOf(keys[i])), i};
+        sort(order.begin(), order.end());
+        return order;
+    }
+
+    // Every entry entering or leaving a shard's index passes through these two
+    // so byte accounting and the eviction policy stay in step
+    static void track(Shard &shard, Entry *entry)
+    {
+        shard.bytes += entry->footprint();
+        if (shard.policy)
+            shard.policy->onInsert(entry);
+    }
+
+    static void untrack(Shard &shard, Entry *entry)
+    {
+        shard.bytes -= entry->footprint();
+        if (shard.policy)
+            shard.policy->onRemove(entry);
+    }
+
+    // Readers may still hold the entry, so it is retired rather than deleted
+    static void erase(Shard &shard, Entry *entry)
+    {
+        untrack(shard, entry);
+        shard.wheel.cancel(entry);
+        shard.mp.erase(entry->key);
+        EpochDomain::global().retire(entry, Entry::destroy);
+    }
+
+    void evictIfNeeded(Shard &shard)
+    {
+        while (shard.policy && shard.bytes > shard.budget)
+        {
+            Entry *victim = shard.policy->victim();
+            if (!victim)
+                break;
+            if (log)
+                log->append(AppendLog::DEL, victim->key, {}, 0);
+            erase(shard, victim);
+        }
+    }
+
+    // Publishes a fully built entry, replacing any previous one for its key.
+    // Caller holds shard.mtx and calls notifyCleanup afterwards.
+    void insertLocked(Shard &shard, Entry *entry)
+    {
+        entry->version.store(++shard.versions, memory_order_relaxed);
+        Entry *old = shard.mp.find(entry->key);
+        shard.mp.assign(entry);
+        shard.wheel.schedule(entry, entry->expiry.load());
+        track(shard, entry);
+
+        if (old)
+        {
+            untrack(shard, old);
+            shard.wheel.cancel(old);
+            EpochDomain::global().retire(old, Entry::destroy);
+        }
+
+        logSet(entry);
+        evictIfNeeded(shard);
+    }
+
+    // Appended under the shard lock so the log orders writes per key
+    void logSet(const Entry *entry)
+    {
+        char digits[24];
+        if (log)
+            log->append(AppendLog::SET, entry->key, entry->text(digits), toUnixMs(entry->expiry.load()));
+    }
+
+    // Called after a write, outside the shard lock
+    void awaitLog()
+    {
+        if (log && syncWrites && !log->waitDurable())
+            throw runtime_error("append log failed: " + log->error());
+    }
+
+    // Live entry for key, or nullptr; caller holds shard.mtx
+    static Entry *findLive(Shard &shard, string_view key, TimePoint now)
+    {
+        Entry *entry = shard.mp.find(key);
+        return entry && entry->expiry.load() > now ? entry : nullptr;
+    }
+
+    void insert(Shard &shard, Entry *entry)
+    {
+        // Read first: once the lock drops the entry may be replaced and freed
+        TimePoint expiry = entry->expiry.load();
+        {
+            lock_guard<mutex> lock(shard.mtx);
+            insertLocked(shard, entry);
+        }
+        notifyCleanup(expiry);
+    }
+
+    void notifyCleanup(TimePoint expiry)
+    {
+        if (lowerNextCleanup(expiry))
+        {
+            lock_guard<mutex> lock(cleanupMtx);
+            cv.notify_one();
+        }
+    }
+
+    // Caller holds shard.mtx
+    bool removeLocked(Shard &shard, string_view key)
+    {
+        Entry *entry = shard.mp.find(key);
+        if (!entry)
+            return false;
+        if (log)
+            log->append(AppendLog::DEL, key, {}, 0);
+        erase(shard, entry);
+        return true;
+    }
+
+    bool removeKey(string_view key)
+    {
+        Shard &shard = shardFor(key);
+        lock_guard<mutex> lock(shard.mtx);
+        return removeLocked(shard, key);
+    }
+
+    void restoreRecord(string_view key, string_view value, int64_t expiryUnixMs)
+    {
+        Shard &shard = shardFor(key);
+        insert(shard, Entry::create(*shard.slab, key, value, fromUnixMs(expiryUnixMs)));
+    }
+
+    // Sections are independent, so loader threads claim them one at a time.
+    // Returns how many sections were skipped as damaged.
+    size_t restoreSnapshot(const SnapshotReader &snapshot, unsigned threads)
+    {
+        atomic<size_t> nextSection{0};
+        atomic<size_t> damaged{0};
+        int64_t nowMs = toUnixMs(chrono::steady_clock::now());
+        vector<thread> loaders;
+
+        for (unsigned t = 0; t < max(threads, 1u); t++)
+        {
+            loaders.emplace_back([&]()
+                                 {
+                for (size_t s = nextSection++; s < snapshot.sectionCount(); s = nextSection++)
+                {
+                    bool intact = snapshot.forEach(s, [&](string_view key, string_view value, int64_t expiry)
+                                                   {
+                        if (expiry > nowMs)
+                            restoreRecord(key, value, expiry); });
+                    if (!intact)
+                        damaged++;
+                } });
+        }
+        for (auto &loader : loaders)
+            loader.join();
+        return damaged;
+    }
+
+    void snapshotLoop(chrono::seconds interval)
+    {
+        unique_lock<mutex> lock(cleanupMtx);
+        while (!snapshotCv.wait_for(lock, interval, [this]
+                                    { return stop; }))
+        {
+            lock.unlock();
+            try
+            {
+                snapshot();
+            }
+            catch (const exception &e)
+            {
+                cerr << "snapshot: " << e.what() << endl;
+            }
+            lock.lock();
+        }
+    }
+
+    // Returns true if exp became the new earliest deadline
+    bool lowerNextCleanup(TimePoint exp)
+    {
+        auto ticks = exp.time_since_epoch().count();
+        auto current = nextCleanup.load();
+        while (ticks < current)
+        {
+            if (nextCleanup.compare_exchange_weak(current, ticks))
+                return true;
+        }
+        return false;
+    }
+
+    void sweep()
+    {
+        auto start = chrono::steady_clock::now();
+
+        // Setters racing with the sweep lower this again, so nothing is lost
+        nextCleanup.store(NO_EXPIRY);
+
+        for (auto &shard : shards)
+        {
+            lock_guard<mutex> lock(shard->mtx);
+            auto now = chrono::steady_clock::now();
+
+            shard->wheel.advance(now, [&](TimerNode *node)
+                                 { erase(*shard, static_cast<Entry *>(node)); });
+
+            if (shard->wheel.size())
+                lowerNextCleanup(shard->wheel.nextExpiry());
+        }
+
+        EpochDomain::global().collect();
+        statsCollector.record(CLEANUP_LATENCY, chrono::steady_clock::now() - start);
+    }
+
+    void statsLoop(Duration interval, ostream *out)
+    {
+        unique_lock<mutex> lock(cleanupMtx);
+        while (!statsCv.wait_for(lock, interval, [this]
+                                 { return stop; }))
+        {
+            lock.unlock();
+            *out << stats().format() << flush;
+            lock.lock();
+        }
+    }
+
+    // Drains the queue before exiting
+    void refreshLoop()
+    {
+        unique_lock<mutex> lock(cleanupMtx);
+        while (true)
+        {
+            refreshCv.wait(lock, [this]
+                           { return stop || !refreshQueue.empty(); });
+            if (refreshQueue.empty())
+                return;
+            auto task = std::move(refreshQueue.front());
+            refreshQueue.pop_front();
+
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    // Stale (inside the revalidate window) or picked for early refresh by
+    // XFetch: now - cost * beta * ln(rand) >= fresh-until
+    static bool wantsReload(const Entry *entry, TimePoint now, const LoadOptions &options)
+    {
+        TimePoint freshUntil = entry->expiry.load() - chrono::milliseconds(entry->staleMs);
+        if (now >= freshUntil)
+            return true;
+        if (options.earlyRefreshBeta <= 0 || !entry->loadCostUs)
+            return false;
+
+        static thread_local mt19937 rng(random_device{}());
+        double gap = -std::log(uniform_real_distribution<double>(numeric_limits<double>::min(), 1)(rng));
+        auto early = chrono::duration<double, micro>(entry->loadCostUs * options.earlyRefreshBeta * gap);
+        return now + chrono::duration_cast<Duration>(early) >= freshUntil;
+    }
+
+    // Leader side of a single-flight load: runs the loader, publishes the
+    // value, then wakes the waiters (or hands them the loader's exception)
+    template <typename Loader>
+    void runLoad(Shard &shard, const string &key, Loader &loader, Duration ttl, const LoadOptions &options)
+    {
+        try
+        {
+            auto start = chrono::steady_clock::now();
+            string value = loader(key);
+            auto now = chrono::steady_clock::now();
+
+            Entry *entry = Entry::create(*shard.slab, key, value, now + ttl + options.staleWhileRevalidate);
+            entry->staleMs = chrono::duration_cast<chrono::milliseconds>(options.staleWhileRevalidate).count();
+            entry->loadCostUs = max<int64_t>(chrono::duration_cast<chrono::microseconds>(now - start).count(), 1);
+            insert(shard, entry);
+
+            shard.loads.complete(key, std::move(value));
+        }
+        catch (...)
+        {
+            shard.loads.fail(key, current_exception());
+        }
+    }
+
+    // Queues a reload unless one for key is already in flight
+    template <typename Loader>
+    void reloadInBackground(Shard &shard, string key, Loader loader, Duration ttl, LoadOptions options)
+    {
+        bool leader;
+        shard.loads.join(key, leader);
+        if (!leader)
+            return;
+
+        lock_guard<mutex> lock(cleanupMtx);
+        refreshQueue.push_back([this, &shard, key = std::move(key), loader = std::move(loader), ttl, options]() mutable
+                               { runLoad(shard, key, loader, ttl, options); });
+        if (!refreshThread.joinable())
+            refreshThread = thread(&KeyValueStore::refreshLoop, this);
+        refreshCv.notify_one();
+    }
+
+    ValueHandle lookup(string_view key)
+    {
+        Shard &shard = shardFor(key);
+        EpochGuard guard;
+        Entry *entry;
+
+        if constexpr (Map::LOCK_FREE_READS)
+            entry = shard.mp.find(key);
+        else
+        {
+            lock_guard<mutex> lock(shard.mtx);
+            entry = shard.mp.find(key);
+        }
+
+        if (!entry or entry->expiry.load() <= chrono::steady_clock::now())
+            return {};
+        if (shard.policy)
+            shard.policy->onAccess(entry);
+        return ValueHandle(std::move(guard), entry);
+    }
+
+    void passive_cleanup()
+    {
+        unique_lock<mutex> lock(cleanupMtx);
+
+        while (!stop)
+        {
+            auto target = nextCleanup.load();
+            auto changed = [this, target]
+            { return stop || nextCleanup.load() != target; };
+
+            if (target == NO_EXPIRY)
+                cv.wait(lock, changed);
+            else
+                cv.wait_until(lock, TimePoint(Duration(target)), changed);
+
+            if (stop)
+                break;
+
+            if (chrono::steady_clock::now().time_since_epoch().count() < nextCleanup.load())
+                continue;
+
+            // Shards are swept one at a time, never all locked together
+            lock.unlock();
+            sweep();
+            lock.lock();
+        }
+    }
+
+public:
+    // maxBytes == 0 leaves the store unbounded; otherwise each shard gets an
+    // equal slice of the budget and its own instance of the eviction policy
+    KeyValueStore(size_t shardCount = 1, size_t maxBytes = 0, EvictionPolicyType evictionPolicy = LRU)
+    {
+        shardCount = max<size_t>(shardCount, 1);
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            shards.push_back(make_unique<Shard>());
+            if (maxBytes)
+            {
+                shards.back()->budget = maxBytes / shardCount;
+                shards.back()->policy = EvictionPolicy::create(evictionPolicy, shards.back()->budget);
+            }
+        }
+
+        cleanupThread = thread(&KeyValueStore::passive_cleanup, this);
+    }
+
+    ~KeyValueStore()
+    {
+        {
+            lock_guard<mutex> lock(cleanupMtx);
+            stop = true;
+        }
+
+        cv.notify_all();
+        snapshotCv.notify_all();
+        statsCv.notify_all();
+        refreshCv.notify_all();
+
+        // Runs whatever reloads are still queued, so no waiter is left hanging
+        if (refreshThread.joinable())
+            refreshThread.join();
+
+        if (cleanupThread.joinable())
+            cleanupThread.join();
+        if (snapshotThread.joinable())
+            snapshotThread.join();
+        if (statsThread.joinable())
+            statsThread.join();
+
+        // Final group commit before the entries go away
+        log.reset();
+    }
+
+    void set(string_view key, string_view value, Duration duration)
+    {
+        bool sampled = statsCollector.shouldSample();
+        auto start = chrono::steady_clock::now();
+
+        Shard &shard = shardFor(key);
+        insert(shard, Entry::create(*shard.slab, key, value, start + duration));
+        awaitLog();
+
+        if (sampled)
+            statsCollector.record(WRITE_ACCESS, key, SET_LATENCY, chrono::steady_clock::now() - start);
+    }
+
+    string get(string key)
+    {
+        ValueHandle handle = view(key);
+        if (!handle)
+            return NA;
+        return string(handle.value());
+    }
+
+    // Lock-free with FlatBackend; TreeBackend falls back to the shard lock
+    ValueHandle view(string_view key)
+    {
+        if (!statsCollector.shouldSample())
+            return lookup(key);
+
+        auto start = chrono::steady_clock::now();
+        ValueHandle handle = lookup(key);
+        statsCollector.record(READ_ACCESS, key, GET_LATENCY, chrono::steady_clock::now() - start);
+        return handle;
+    }
+
+    bool del(string_view key)
+    {
+        bool removed = removeKey(key);
+        awaitLog();
+        return removed;
+    }
+
+    // Read-through get. On a miss, concurrent callers for the same key share
+    // a single loader(key) call and its result (or exception); the value is
+    // cached for ttl. Hits may trigger one background reload, early (see
+    // LoadOptions::earlyRefreshBeta) or while being served stale; loader must
+    // be copyable for that. Plain get() also sees a value while it is stale.
+    template <typename Loader>
+    string getOrLoad(string_view key, Loader loader, Duration ttl, LoadOptions options = {})
+    {
+        Shard &shard = shardFor(key);
+        {
+            ValueHandle handle = view(key);
+            if (handle)
+            {
+                if (wantsReload(handle.entry, chrono::steady_clock::now(), options))
+                    reloadInBackground(shard, string(key), loader, ttl, options);
+                return string(handle.value());
+            }
+        }
+
+        string name(key);
+        bool leader;
+        shared_future<string> result = shard.loads.join(name, leader);
+        if (leader)
+        {
+            // Another leader may have published while this caller was missing
+            ValueHandle handle = view(key);
+            if (handle)
+                shard.loads.complete(name, string(handle.value()));
+            else
+                runLoad(shard, name, loader, ttl, options);
+        }
+        return result.get();
+    }
+
+    // Replaces the value only if the key's version still equals expectedVersion
+    // (from ValueHandle::version); 0 expects the key to be absent
+    bool compareAndSet(string_view key, uint64_t expectedVersion, string_view value, Duration duration)
+    {
+        Shard &shard = shardFor(key);
+        auto now = chrono::steady_clock::now();
+        Entry *entry = Entry::create(*shard.slab, key, value, now + duration);
+        bool swapped;
+        {
+            lock_guard<mutex> lock(shard.mtx);
+            Entry *current = findLive(shard, key, now);
+            swapped = (current ? current->version.load(memory_order_relaxed) : 0) == expectedVersion;
+            if (swapped)
+                insertLocked(shard, entry);
+        }
+
+        if (!swapped)
+            Entry::destroy(entry);
+        else
+        {
+            notifyCleanup(now + duration);
+            awaitLog();
+        }
+        return swapped;
+    }
+
+    // Adds delta to the counter at key and returns the result. An absent key
+    // starts from 0 and lives for duration; otherwise the TTL is kept. A
+    // counter is updated in place; a string value holding an integer is
+    // converted once, anything else throws invalid_argument.
+    int64_t incr(string_view key, int64_t delta, Duration duration)
+    {
+        Shard &shard = shardFor(key);
+        auto now = chrono::steady_clock::now();
+        TimePoint expiry = now + duration;
+        int64_t result;
+        bool inserted = false;
+        {
+            lock_guard<mutex> lock(shard.mtx);
+            Entry *entry = findLive(shard, key, now);
+
+            if (entry && entry->numeric)
+            {
+                // Writers are serialised here, so load + store is atomic enough
+                if (__builtin_add_overflow(entry->counter.load(memory_order_relaxed), delta, &result))
+                    throw out_of_range("increment would overflow");
+                entry->counter.store(result, memory_order_relaxed);
+                entry->version.store(++shard.versions, memory_order_relaxed);
+                logSet(entry);
+            }
+            else
+            {
+                int64_t base = 0;
+                if (entry)
+                {
+                    if (!parseInteger(entry->value, base))
+                        throw invalid_argument("value is not an integer");
+                    expiry = entry->expiry.load();
+                }
+                if (__builtin_add_overflow(base, delta, &result))
+                    throw out_of_range("increment would overflow");
+                insertLocked(shard, Entry::createCounter(*shard.slab, key, result, expiry));
+                inserted = true;
+            }
+        }
+        if (inserted)
+            notifyCleanup(expiry);
+        awaitLog();
+        return result;
+    }
+
+    int64_t decr(string_view key, int64_t delta, Duration duration)
+    {
+        return incr(key, -delta, duration);
+    }
+
+    // Reads the value and moves its expiry to now + duration in place
+    ValueHandle getAndTouch(string_view key, Duration duration)
+    {
+        Shard &shard = shardFor(key);
+        EpochGuard guard;
+        auto now = chrono::steady_clock::now();
+        Entry *entry;
+        {
+            lock_guard<mutex> lock(shard.mtx);
+            entry = findLive(shard, key, now);
+            if (!entry)
+                return {};
+            entry->expiry.store(now + duration);
+            shard.wheel.schedule(entry, now + duration);
+            logSet(entry);
+            if (shard.policy)
+                shard.policy->onAccess(entry);
+        }
+        notifyCleanup(now + duration);
+        awaitLog();
+        return ValueHandle(std::move(guard), entry);
+    }
+
+    // Batched get: one epoch pin for the whole batch (one lock per shard on
+    // TreeBackend), with the next slots prefetched while probing the current
+    vector<string> mget(const vector<string> &keys)
+    {
+        static constexpr size_t PREFETCH_DISTANCE = 8;
+
+        vector<string> values(keys.size(), NA);
+        EpochGuard guard;
+        auto now = chrono::steady_clock::now();
+
+        auto lookup = [&](Shard &shard, size_t i, size_t hash)
+        {
+            Entry *entry = shard.mp.find(keys[i], hash);
+            if (!entry or entry->expiry.load() <= now)
+                return;
+            if (shard.policy)
+                shard.policy->onAccess(entry);
+            char digits[24];
+            values[i] = entry->text(digits);
+        };
+
+        if constexpr (Map::LOCK_FREE_READS)
+        {
+            vector<size_t> hashes(keys.size());
+            auto prefetch = [&](size_t i)
+            {
+                hashes[i] = shardFor(keys[i]).mp.hashFor(keys[i]);
+                shardFor(keys[i]).mp.prefetch(hashes[i]);
+            };
+
+            for (size_t i = 0; i < min(PREFETCH_DISTANCE, keys.size()); i++)
+                prefetch(i);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (i + PREFETCH_DISTANCE < keys.size())
+                    prefetch(i + PREFETCH_DISTANCE);
+                lookup(shardFor(keys[i]), i, hashes[i]);
+                if (statsCollector.shouldSample())
+                    statsCollector.recordAccess(READ_ACCESS, keys[i]);
+            }
+        }
+        else
+        {
+            auto order = groupByShard(keys, [](const string &key) -> const string &
+                                      { return key; });
+            for (size_t begin = 0; begin < order.size();)
+            {
+                Shard &shard = *shards[order[begin].first];
+                lock_guard<mutex> lock(shard.mtx);
+                size_t end = begin;
+                for (; end < order.size() && order[end].first == order[begin].first; end++)
+                {
+                    lookup(shard, order[end].second, 0);
+                    if (statsCollector.shouldSample())
+                        statsCollector.recordAccess(READ_ACCESS, keys[order[end].second]);
+                }
+                begin = end;
+            }
+        }
+        return values;
+    }
+
+    // Batched set with a shared TTL: entries are built outside any lock, each
+    // shard is locked once, and the cleanup thread is notified at most once
+    void mset(const vector<pair<string, string>> &items, Duration duration)
+    {
+        auto exp = chrono::steady_clock::now() + duration;
+        auto order = groupByShard(items, [](const pair<string, string> &item) -> const string &
+                                  { return item.first; });
+
+        vector<Entry *> entries(items.size());
+        for (auto [shardIdx, i] : order)
+        {
+            entries[i] = Entry::create(*shards[shardIdx]->slab, items[i].first, items[i].second, exp);
+            if (statsCollector.shouldSample())
+                statsCollector.recordAccess(WRITE_ACCESS, items[i].first);
+        }
+
+        for (size_t begin = 0; begin < order.size();)
+        {
+            Shard &shard = *shards[order[begin].first];
+            size_t end = begin;
+            while (end < order.size() && order[end].first == order[begin].first)
+                shard.mp.prefetch(shard.mp.hashFor(entries[order[end++].second]->key));
+
+            lock_guard<mutex> lock(shard.mtx);
+            // Same-key items keep their relative order, so the last one wins
+            for (size_t i = begin; i < end; i++)
+                insertLocked(shard, entries[order[i].second]);
+            begin = end;
+        }
+
+        if (!items.empty())
+            notifyCleanup(exp);
+        awaitLog();
+    }
+
+    // Returns how many of the keys were present
+    size_t mdelete(const vector<string> &keys)
+    {
+        auto order = groupByShard(keys, [](const string &key) -> const string &
+                                  { return key; });
+        size_t removed = 0;
+
+        for (size_t begin = 0; begin < order.size();)
+        {
+            Shard &shard = *shards[order[begin].first];
+            lock_guard<mutex> lock(shard.mtx);
+            size_t end = begin;
+            for (; end < order.size() && order[end].first == order[begin].first; end++)
+                removed += removeLocked(shard, keys[order[end].second]);
+            begin = end;
+        }
+        awaitLog();
+        return removed;
+    }
+
+    // Loads dir's snapshot (in parallel) and replays the logs written after
+    // it, then logs every later write there. Call once, before the store is
+    // shared with other threads.
+    void enablePersistence(const string &dir, PersistenceOptions options = {})
+    {
+        ::mkdir(dir.c_str(), 0755);
+
+        uint64_t nextGeneration;
+        {
+            SnapshotReader snapshot(dir + "/snapshot.bin");
+            if (size_t damaged = restoreSnapshot(snapshot, options.loaderThreads))
+                cerr << "snapshot: skipped " << damaged << " damaged section(s) of " << snapshot.sectionCount() << endl;
+            nextGeneration = snapshot.generation();
+        }
+
+        for (uint64_t gen : logGenerations(dir))
+        {
+            if (gen < nextGeneration)
+                continue;
+            AppendLog::replay(AppendLog::pathFor(dir, gen), [this](const AppendLog::Record &record)
+                              {
+                if (record.op == AppendLog::DEL)
+                    removeKey(string(record.key));
+                else if (fromUnixMs(record.expiryUnixMs) > chrono::steady_clock::now())
+                    restoreRecord(record.key, record.value, record.expiryUnixMs); });
+            // Never append behind a possibly torn tail
+            nextGeneration = gen + 1;
+        }
+
+        persistDir = dir;
+        log = make_unique<AppendLog>(dir, nextGeneration, options.flushInterval);
+        syncWrites = options.syncEveryWrite;
+
+        if (options.snapshotInterval.count() > 0)
+            snapshotThread = thread(&KeyValueStore::snapshotLoop, this, options.snapshotInterval);
+    }
+
+    // Empty unless the append log failed; writes are no longer logged then
+    string persistenceError()
+    {
+        return log && log->failed() ? log->error() : string();
+    }
+
+    // Writes a compacted snapshot and deletes the logs it supersedes
+    void snapshot()
+    {
+        if (!log)
+            return;
+        lock_guard<mutex> single(snapshotMtx);
+
+        uint64_t generation = log->rotate();
+        SnapshotWriter writer(persistDir + "/snapshot.bin", generation);
+
+        for (auto &shard : shards)
+        {
+            // Copy pointers under the lock, serialise outside it
+            EpochGuard guard;
+            vector<Entry *> live;
+            {
+                lock_guard<mutex> lock(shard->mtx);
+                live.reserve(shard->mp.size());
+                shard->mp.forEach([&](Entry *entry)
+                                  { live.push_back(entry); });
+            }
+
+            auto now = chrono::steady_clock::now();
+            char digits[24];
+            for (Entry *entry : live)
+                if (entry->expiry.load() > now)
+                    writer.add(entry->key, entry->text(digits), toUnixMs(entry->expiry.load()));
+        }
+        writer.commit();
+
+        for (uint64_t gen : logGenerations(persistDir))
+            if (gen < generation)
+                ::unlink(AppendLog::pathFor(persistDir, gen).c_str());
+    }
+
+    // Pre-sizes every shard for roughly n keys in total
+    void reserve(size_t n)
+    {
+        for (auto &shard : shards)
+        {
+            lock_guard<mutex> lock(shard->mtx);
+            shard->mp.reserve(n / shards.size() + 1);
+        }
+    }
+
+    // Live plus not-yet-reaped entries
+    size_t size()
+    {
+        size_t total = 0;
+        for (auto &shard : shards)
+        {
+            lock_guard<mutex> lock(shard->mtx);
+            total += shard->mp.size();
+        }
+        return total;
+    }
+
+    // Bytes charged against the budget (see Entry::footprint)
+    size_t bytesUsed()
+    {
+        size_t total = 0;
+        for (auto &shard : shards)
+        {
+            lock_guard<mutex> lock(shard->mtx);
+            total += shard->bytes;
+        }
+        return total;
+    }
+
+    // Hottest sampled keys, latency histograms and expiry queue depth
+    StatsSnapshot stats(size_t topK = 10)
+    {
+        StatsSnapshot result = statsCollector.snapshot(topK);
+        for (auto &shard : shards)
+        {
+            lock_guard<mutex> lock(shard->mtx);
+            result.keys += shard->mp.size();
+            result.expiryQueueDepth += shard->wheel.size();
+        }
+        return result;
+    }
+
+    // One op in rate (on average) is timed and counted; 0 turns sampling off
+    void setStatsSampleRate(uint32_t rate)
+    {
+        statsCollector.setSampleRate(rate);
+    }
+
+    // Writes stats().format() to out every interval until the store closes
+    void enableStatsDump(Duration interval, ostream &out = cerr)
+    {
+        statsThread = thread(&KeyValueStore::statsLoop, this, interval, &out);
+    }
+
+    // Slab usage summed over shards: one row per size class, then oversized
+    vector<SlabClassStats> memoryStats()
+    {
+        vector<SlabClassStats> total;
+        for (auto &shard : shards)
+        {
+            auto stats = shard->slab->stats();
+            total.resize(stats.size());
+            for (size_t i = 0; i < stats.size(); i++)
+                total[i] += stats[i];
+        }
+        return total;
+    }
+
+    size_t shardCount() const
+    {
+        return shards.size();
+    }
+};
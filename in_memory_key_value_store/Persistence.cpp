@@ -0,0 +1,592 @@
+#include "bits/stdc++.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#pragma once
+
+// On disk, expiries are wall-clock milliseconds so TTLs survive a restart;
+// in memory they stay on the steady clock
+static int64_t toUnixMs(chrono::steady_clock::time_point tp)
+{
+    auto wall = chrono::system_clock::now() + chrono::duration_cast<chrono::system_clock::duration>(tp - chrono::steady_clock::now());
+    return chrono::duration_cast<chrono::milliseconds>(wall.time_since_epoch()).count();
+}
+
+static chrono::steady_clock::time_point fromUnixMs(int64_t ms)
+{
+    auto wall = chrono::system_clock::time_point(chrono::milliseconds(ms));
+    return chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(wall - chrono::system_clock::now());
+}
+
+static uint32_t fnv1a(const char *data, size_t n, uint32_t h = 2166136261u)
+{
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ uint8_t(data[i])) * 16777619u;
+    return h;
+}
+
+// Buffered append-only file on a raw fd so it can be fdatasync'ed
+class FileWriter
+{
+private:
+    int fd = -1;
+    string buffer;
+
+public:
+    explicit FileWriter(const string &path, bool truncate = false)
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+        if (fd < 0)
+            throw runtime_error("cannot open " + path + ": " + strerror(errno));
+    }
+
+    FileWriter(const FileWriter &) = delete;
+    FileWriter &operator=(const FileWriter &) = delete;
+
+    // Call flush() or sync() first to see write errors; here they can only
+    // be reported
+    ~FileWriter()
+    {
+        try
+        {
+            flush();
+        }
+        catch (const exception &e)
+        {
+            cerr << "FileWriter: " << e.what() << endl;
+        }
+        ::close(fd);
+    }
+
+    template <typename T>
+    void put(const T &value)
+    {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void put(string_view bytes)
+    {
+        buffer.append(bytes.data(), bytes.size());
+        if (buffer.size() >= (1 << 20))
+            flush();
+    }
+
+    void write(const string &bytes)
+    {
+        buffer += bytes;
+        flush();
+    }
+
+    void flush()
+    {
+        size_t done = 0;
+        while (done < buffer.size())
+        {
+            ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                throw runtime_error(string("write failed: ") + strerror(errno));
+            done += n;
+        }
+        buffer.clear();
+    }
+
+    void sync()
+    {
+        flush();
+        if (::fdatasync(fd) != 0)
+            throw runtime_error(string("fdatasync failed: ") + strerror(errno));
+    }
+};
+
+// Append-only log of SET/DEL records. Writers only copy into a shared buffer;
+// a flusher thread writes and fdatasyncs it every flushInterval, so one sync
+// commits every record appended in that window. Losing the last window on a
+// crash is the accepted trade-off, as with appendfsync everysec.
+//
+// A failed write or sync leaves the file in an unknown state, so the log
+// stops there: it keeps the error, drops later appends and fails waiters.
+//
+// Record: op u8 | key len u32 | value len u32 | expiry unix ms i64 | key | value | fnv1a u32
+class AppendLog
+{
+public:
+    enum Op : uint8_t
+    {
+        SET = 1,
+        DEL = 2
+    };
+
+    struct Record
+    {
+        Op op;
+        string_view key;
+        string_view value;
+        int64_t expiryUnixMs;
+    };
+
+private:
+    string dir;
+
+    // ioMtx serialises file writes and rotation; mtx only guards pending
+    mutex ioMtx;
+    uint64_t generation;
+    unique_ptr<FileWriter> file;
+
+    // Records are numbered as appended; durable is the last one synced
+    string pending;
+    uint64_t appended = 0;
+    uint64_t durable = 0;
+    bool syncRequested = false;
+    string failure;
+    atomic<bool> broken{false};
+    mutex mtx;
+    condition_variable cv;
+    condition_variable durableCv;
+    chrono::milliseconds flushInterval;
+
+    thread flusher;
+    bool stop = false;
+
+    void flushLoop()
+    {
+        bool stopping = false;
+        while (!stopping)
+        {
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait_for(lock, flushInterval, [this]
+                            { return stop || syncRequested; });
+                syncRequested = false;
+                stopping = stop;
+            }
+            commit();
+        }
+    }
+
+    void fail(const string &reason)
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (broken)
+                return;
+            failure = reason;
+            broken = true;
+            pending.clear();
+        }
+        cerr << "AppendLog: " << reason << ", no longer logging writes" << endl;
+        durableCv.notify_all();
+    }
+
+    // Takes pending under the lock and writes it out; caller holds ioMtx
+    void writePending()
+    {
+        string batch;
+        uint64_t upTo;
+        {
+            lock_guard<mutex> lock(mtx);
+            batch.swap(pending);
+            upTo = appended;
+        }
+        if (broken)
+            return;
+        if (!batch.empty())
+        {
+            try
+            {
+                file->write(batch);
+                file->sync();
+            }
+            catch (const exception &e)
+            {
+                fail(e.what());
+                return;
+            }
+        }
+        {
+            lock_guard<mutex> lock(mtx);
+            durable = upTo;
+        }
+        durableCv.notify_all();
+    }
+
+    // Appenders only wait for the buffer swap, never on disk
+    void commit()
+    {
+        lock_guard<mutex> io(ioMtx);
+        writePending();
+    }
+
+public:
+    static string pathFor(const string &dir, uint64_t generation)
+    {
+        return dir + "/aof." + to_string(generation);
+    }
+
+    AppendLog(const string &dir, uint64_t generation, chrono::milliseconds flushInterval)
+        : dir(dir), generation(generation), file(make_unique<FileWriter>(pathFor(dir, generation))), flushInterval(flushInterval)
+    {
+        flusher = thread(&AppendLog::flushLoop, this);
+    }
+
+    ~AppendLog()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        if (flusher.joinable())
+            flusher.join();
+    }
+
+    // False once the log has failed; the record is dropped
+    bool append(Op op, string_view key, string_view value, int64_t expiryUnixMs)
+    {
+        uint32_t keyLen = key.size(), valueLen = value.size();
+        size_t start;
+
+        lock_guard<mutex> lock(mtx);
+        if (broken)
+            return false;
+        start = pending.size();
+        pending.push_back(char(op));
+        pending.append(reinterpret_cast<const char *>(&keyLen), 4);
+        pending.append(reinterpret_cast<const char *>(&valueLen), 4);
+        pending.append(reinterpret_cast<const char *>(&expiryUnixMs), 8);
+        pending.append(key.data(), key.size());
+        pending.append(value.data(), value.size());
+        uint32_t checksum = fnv1a(pending.data() + start, pending.size() - start);
+        pending.append(reinterpret_cast<const char *>(&checksum), 4);
+        appended++;
+        return true;
+    }
+
+    // Blocks until every record appended so far is synced. False if the
+    // log failed first.
+    bool waitDurable()
+    {
+        unique_lock<mutex> lock(mtx);
+        uint64_t target = appended;
+        if (durable < target && !broken)
+        {
+            syncRequested = true;
+            cv.notify_one();
+            durableCv.wait(lock, [&]
+                           { return durable >= target || broken; });
+        }
+        return !broken;
+    }
+
+    bool failed() const
+    {
+        return broken;
+    }
+
+    string error()
+    {
+        lock_guard<mutex> lock(mtx);
+        return failure;
+    }
+
+    // Starts a new log file and returns its generation. Everything appended
+    // before the call is durable in the previous file once this returns.
+    // Throws if the log has failed, since that is no longer true.
+    uint64_t rotate()
+    {
+        lock_guard<mutex> io(ioMtx);
+        writePending();
+        if (broken)
+            throw runtime_error("append log failed: " + error());
+        file = make_unique<FileWriter>(pathFor(dir, ++generation));
+        return generation;
+    }
+
+    // Replays one log file, stopping at the first torn or corrupt record
+    static size_t replay(const string &path, const function<void(const Record &)> &apply)
+    {
+        ifstream in(path, ios::binary);
+        string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+        size_t pos = 0, applied = 0;
+        const size_t HEADER = 1 + 4 + 4 + 8;
+        while (pos + HEADER <= data.size())
+        {
+            uint32_t keyLen, valueLen;
+            int64_t expiry;
+            memcpy(&keyLen, &data[pos + 1], 4);
+            memcpy(&valueLen, &data[pos + 5], 4);
+            memcpy(&expiry, &data[pos + 9], 8);
+
+            size_t end = pos + HEADER + keyLen + valueLen;
+            if (end + 4 > data.size())
+                break;
+            uint32_t checksum;
+            memcpy(&checksum, &data[end], 4);
+            if (checksum != fnv1a(&data[pos], end - pos))
+                break;
+
+            string_view body(&data[pos + HEADER], keyLen + valueLen);
+            apply({Op(data[pos]), body.substr(0, keyLen), body.substr(keyLen), expiry});
+            applied++;
+            pos = end + 4;
+        }
+        return applied;
+    }
+};
+
+// Compacted point-in-time image, laid out for mmap and parallel loading:
+//
+//   header:  magic[8] | log generation u64
+//   records: key len u32 | value len u32 | expiry unix ms i64 | key | value
+//   table:   (offset u64, count u64, bytes u64, fnv1a u64) per section
+//   footer:  table offset u64 | section count u64 | record count u64 | magic[8]
+//
+// Sections are independent runs of records so loaders can split them up,
+// and each carries its own checksum so loaders can verify them in parallel.
+struct SnapshotSection
+{
+    uint64_t offset;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+
+class SnapshotWriter
+{
+private:
+    static constexpr size_t SECTION_RECORDS = 1 << 16;
+
+    string tmpPath, finalPath;
+    unique_ptr<FileWriter> file;
+    uint64_t offset = 0;
+    vector<SnapshotSection> sections;
+    uint64_t total = 0;
+
+    template <typename T>
+    void put(const T &value)
+    {
+        file->put(value);
+        offset += sizeof(T);
+    }
+
+    void put(string_view bytes)
+    {
+        file->put(bytes);
+        offset += bytes.size();
+    }
+
+    // Writes part of a record and folds it into its section
+    template <typename T>
+    void putRecord(const T &value)
+    {
+        putRecord(string_view(reinterpret_cast<const char *>(&value), sizeof(T)));
+    }
+
+    void putRecord(string_view bytes)
+    {
+        put(bytes);
+        SnapshotSection &section = sections.back();
+        section.bytes += bytes.size();
+        section.checksum = fnv1a(bytes.data(), bytes.size(), section.checksum);
+    }
+
+public:
+    static constexpr char MAGIC[9] = "KVSNAP02";
+
+    SnapshotWriter(const string &path, uint64_t logGeneration)
+        : tmpPath(path + ".tmp"), finalPath(path), file(make_unique<FileWriter>(tmpPath, true))
+    {
+        put(string_view(MAGIC, 8));
+        put(logGeneration);
+    }
+
+    void add(string_view key, string_view value, int64_t expiryUnixMs)
+    {
+        if (sections.empty() || sections.back().count == SECTION_RECORDS)
+            sections.push_back({offset, 0, 0, fnv1a(nullptr, 0)});
+        sections.back().count++;
+        total++;
+
+        putRecord(uint32_t(key.size()));
+        putRecord(uint32_t(value.size()));
+        putRecord(expiryUnixMs);
+        putRecord(key);
+        putRecord(value);
+    }
+
+    // Syncs and atomically replaces the previous snapshot
+    void commit()
+    {
+        uint64_t tableOffset = offset;
+        for (auto &section : sections)
+        {
+            put(section.offset);
+            put(section.count);
+            put(section.bytes);
+            put(section.checksum);
+        }
+        put(tableOffset);
+        put(uint64_t(sections.size()));
+        put(total);
+        put(string_view(MAGIC, 8));
+
+        file->sync();
+        file.reset();
+        if (::rename(tmpPath.c_str(), finalPath.c_str()) != 0)
+            throw runtime_error("cannot install snapshot: " + string(strerror(errno)));
+    }
+};
+
+class SnapshotReader
+{
+private:
+    int fd = -1;
+    const char *base = nullptr;
+    size_t length = 0;
+    vector<SnapshotSection> sections;
+    uint64_t logGeneration = 0;
+
+public:
+    // A missing file, or one whose header, footer or section table is
+    // damaged, reads as an empty snapshot at generation 0. Damage inside a
+    // section is caught by forEach.
+    explicit SnapshotReader(const string &path)
+    {
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < 48)
+            return;
+
+        length = st.st_size;
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            length = 0;
+            return;
+        }
+        base = static_cast<const char *>(mapped);
+        madvise(mapped, length, MADV_SEQUENTIAL);
+
+        const char *footer = base + length - 32;
+        uint64_t tableOffset, sectionCount;
+        memcpy(&tableOffset, footer, 8);
+        memcpy(&sectionCount, footer + 8, 8);
+        if (memcmp(base, SnapshotWriter::MAGIC, 8) != 0 || memcmp(footer + 24, SnapshotWriter::MAGIC, 8) != 0)
+            return;
+        // Written this way round so no field can overflow the check
+        if (tableOffset < 16 || tableOffset > length - 32 ||
+            sectionCount != (length - 32 - tableOffset) / sizeof(SnapshotSection) ||
+            (length - 32 - tableOffset) % sizeof(SnapshotSection) != 0)
+            return;
+
+        vector<SnapshotSection> table(sectionCount);
+        memcpy(table.data(), base + tableOffset, sectionCount * sizeof(SnapshotSection));
+        for (auto &section : table)
+            if (section.offset < 16 || section.offset > tableOffset || section.bytes > tableOffset - section.offset ||
+                section.count > section.bytes / 16)
+                return;
+
+        memcpy(&logGeneration, base + 8, 8);
+        sections = std::move(table);
+    }
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    ~SnapshotReader()
+    {
+        if (base)
+            munmap(const_cast<char *>(base), length);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    size_t sectionCount() const
+    {
+        return sections.size();
+    }
+
+    uint64_t generation() const
+    {
+        return logGeneration;
+    }
+
+    // Visits records of one section straight out of the mapping. A section
+    // whose checksum or record lengths do not add up is skipped whole, and
+    // reported by returning false.
+    template <typename F>
+    bool forEach(size_t section, F f) const
+    {
+        const SnapshotSection &s = sections[section];
+        const char *start = base + s.offset;
+        if (fnv1a(start, s.bytes) != s.checksum)
+            return false;
+
+        // Bounds first, so a bad section leaves nothing half-applied
+        size_t pos = 0;
+        for (uint64_t i = 0; i < s.count; i++)
+        {
+            uint32_t keyLen, valueLen;
+            if (s.bytes - pos < 16)
+                return false;
+            memcpy(&keyLen, start + pos, 4);
+            memcpy(&valueLen, start + pos + 4, 4);
+            if (s.bytes - pos - 16 < uint64_t(keyLen) + valueLen)
+                return false;
+            pos += 16 + uint64_t(keyLen) + valueLen;
+        }
+        if (pos != s.bytes)
+            return false;
+
+        const char *p = start;
+        for (uint64_t i = 0; i < s.count; i++)
+        {
+            uint32_t keyLen, valueLen;
+            int64_t expiry;
+            memcpy(&keyLen, p, 4);
+            memcpy(&valueLen, p + 4, 4);
+            memcpy(&expiry, p + 8, 8);
+            p += 16;
+            f(string_view(p, keyLen), string_view(p + keyLen, valueLen), expiry);
+            p += keyLen + valueLen;
+        }
+        return true;
+    }
+};
+
+struct PersistenceOptions
+{
+    chrono::milliseconds flushInterval{10};
+    // Zero disables periodic snapshots; snapshot() can still be called
+    chrono::seconds snapshotInterval{300};
+    unsigned loaderThreads = max(1u, thread::hardware_concurrency());
+    // Like appendfsync always: writes return only once logged to disk, and
+    // throw runtime_error if the log has failed
+    bool syncEveryWrite = false;
+};
+
+// Log generations present in dir, oldest first
+static vector<uint64_t> logGenerations(const string &dir)
+{
+    vector<uint64_t> generations;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return generations;
+    while (dirent *item = readdir(d))
+    {
+        string name = item->d_name;
+        if (name.rfind("aof.", 0) == 0 && name.size() > 4 && all_of(name.begin() + 4, name.end(), ::isdigit))
+            generations.push_back(stoull(name.substr(4)));
+    }
+    closedir(d);
+    sort(generations.begin(), generations.end());
+    return generations;
+}
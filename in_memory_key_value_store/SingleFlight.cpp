@@ -0,0 +1,62 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+struct LoadOptions
+{
+    // XFetch beta: a hit reloads early with a probability that grows as expiry
+    // nears and with how long the last load took; 0 disables
+    double earlyRefreshBeta = 1.0;
+
+    // How long past its TTL a loaded value may still be served while a single
+    // background reload replaces it; 0 disables
+    Duration staleWhileRevalidate = Duration::zero();
+};
+
+// Coalesces concurrent calls per key: the first caller becomes the leader and
+// must finish the call; everyone else waits on the same shared future
+template <typename T>
+class SingleFlight
+{
+private:
+    struct Call
+    {
+        promise<T> result;
+        shared_future<T> future = result.get_future().share();
+    };
+
+    mutex mtx;
+    unordered_map<string, Call> calls;
+
+    promise<T> take(const string &key)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto it = calls.find(key);
+        promise<T> result = std::move(it->second.result);
+        calls.erase(it);
+        return result;
+    }
+
+public:
+    shared_future<T> join(const string &key, bool &leader)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto [it, inserted] = calls.try_emplace(key);
+        leader = inserted;
+        return it->second.future;
+    }
+
+    // Leader only. The call is removed before waiters wake, so a new miss
+    // after this point starts a fresh call.
+    void complete(const string &key, T value)
+    {
+        take(key).set_value(std::move(value));
+    }
+
+    void fail(const string &key, exception_ptr error)
+    {
+        take(key).set_exception(error);
+    }
+};
@@ -0,0 +1,255 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+struct SlabClassStats
+{
+    size_t blockSize = 0; // 0 for the oversized class
+    size_t slabs = 0;
+    size_t reservedBytes = 0;
+    size_t blocksInUse = 0;
+    size_t blocksFree = 0;
+    size_t requestedBytes = 0;
+
+    size_t bytesInUse() const
+    {
+        return blockSize ? blocksInUse * blockSize : requestedBytes;
+    }
+
+    // Share of the reserved memory that holds no live data: rounding up to
+    // the block size plus free and not yet carved blocks
+    double fragmentation() const
+    {
+        return reservedBytes ? 1.0 - double(requestedBytes) / reservedBytes : 0;
+    }
+
+    SlabClassStats &operator+=(const SlabClassStats &other)
+    {
+        blockSize = max(blockSize, other.blockSize);
+        slabs += other.slabs;
+        reservedBytes += other.reservedBytes;
+        blocksInUse += other.blocksInUse;
+        blocksFree += other.blocksFree;
+        requestedBytes += other.requestedBytes;
+        return *this;
+    }
+};
+
+// Size-class slab allocator. Memory comes in SLAB_SIZE-aligned slabs, each
+// carved into equal blocks of one class, and freed blocks go on a per-class
+// free list so churn at a given size reuses warm memory instead of going
+// back to malloc. Requests above the largest class get a dedicated slab.
+//
+// Every slab starts with a header naming its owner, so deallocate() needs
+// only the pointer and size. That lets blocks outlive their owner's handle
+// (e.g. while waiting out a reclamation grace period): release() marks the
+// allocator orphaned and it frees itself once the last block comes back.
+class SlabAllocator
+{
+private:
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t ALIGN = 16;
+    static constexpr uint32_t LARGE = numeric_limits<uint32_t>::max();
+
+    struct alignas(ALIGN) SlabHeader
+    {
+        SlabAllocator *owner;
+        uint32_t sizeClass;
+    };
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct SizeClass
+    {
+        size_t blockSize;
+        FreeBlock *freeList = nullptr;
+        char *bump = nullptr;
+        char *bumpEnd = nullptr;
+        SlabClassStats stats;
+    };
+
+    mutex mtx;
+    vector<SizeClass> classes;
+    vector<void *> slabs;
+    SlabClassStats largeStats;
+    size_t liveBlocks = 0;
+    bool orphaned = false;
+
+    // 16-byte steps up to 256, then roughly 25% apart up to 16 KiB
+    static const vector<size_t> &classSizes()
+    {
+        static const vector<size_t> sizes = []()
+        {
+            vector<size_t> result;
+            for (size_t size = ALIGN; size <= 256; size += ALIGN)
+                result.push_back(size);
+            while (result.back() < 16 * 1024)
+                result.push_back((result.back() * 5 / 4 + ALIGN - 1) / ALIGN * ALIGN);
+            return result;
+        }();
+        return sizes;
+    }
+
+    static SlabHeader *headerOf(void *ptr)
+    {
+        return reinterpret_cast<SlabHeader *>(reinterpret_cast<uintptr_t>(ptr) & ~(SLAB_SIZE - 1));
+    }
+
+    void *newSlab(size_t bytes, uint32_t sizeClass)
+    {
+        void *slab = aligned_alloc(SLAB_SIZE, bytes);
+        if (!slab)
+            throw bad_alloc();
+        new (slab) SlabHeader{this, sizeClass};
+        if (sizeClass != LARGE)
+            slabs.push_back(slab);
+        return slab;
+    }
+
+    void *allocateLarge(size_t bytes)
+    {
+        size_t total = (sizeof(SlabHeader) + bytes + SLAB_SIZE - 1) / SLAB_SIZE * SLAB_SIZE;
+        char *slab = static_cast<char *>(newSlab(total, LARGE));
+        largeStats.slabs++;
+        largeStats.reservedBytes += total;
+        largeStats.blocksInUse++;
+        largeStats.requestedBytes += bytes;
+        return slab + sizeof(SlabHeader);
+    }
+
+    void *allocateFrom(SizeClass &sc, uint32_t index)
+    {
+        if (sc.freeList)
+        {
+            FreeBlock *block = sc.freeList;
+            sc.freeList = block->next;
+            sc.stats.blocksFree--;
+            return block;
+        }
+
+        if (sc.bump + sc.blockSize > sc.bumpEnd)
+        {
+            char *slab = static_cast<char *>(newSlab(SLAB_SIZE, index));
+            sc.bump = slab + sizeof(SlabHeader);
+            sc.bumpEnd = slab + SLAB_SIZE;
+            sc.stats.slabs++;
+            sc.stats.reservedBytes += SLAB_SIZE - sizeof(SlabHeader);
+        }
+        void *block = sc.bump;
+        sc.bump += sc.blockSize;
+        return block;
+    }
+
+    // Returns true when this call released the last block of an orphan
+    bool reclaim(void *ptr, size_t bytes, uint32_t sizeClass)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (sizeClass == LARGE)
+        {
+            void *slab = headerOf(ptr);
+            size_t total = (sizeof(SlabHeader) + bytes + SLAB_SIZE - 1) / SLAB_SIZE * SLAB_SIZE;
+            largeStats.slabs--;
+            largeStats.reservedBytes -= total;
+            largeStats.blocksInUse--;
+            largeStats.requestedBytes -= bytes;
+            ::free(slab);
+        }
+        else
+        {
+            SizeClass &sc = classes[sizeClass];
+            FreeBlock *block = static_cast<FreeBlock *>(ptr);
+            block->next = sc.freeList;
+            sc.freeList = block;
+            sc.stats.blocksInUse--;
+            sc.stats.blocksFree++;
+            sc.stats.requestedBytes -= bytes;
+        }
+        return --liveBlocks == 0 && orphaned;
+    }
+
+    SlabAllocator()
+    {
+        for (size_t size : classSizes())
+        {
+            classes.push_back({});
+            classes.back().blockSize = size;
+            classes.back().stats.blockSize = size;
+        }
+    }
+
+    ~SlabAllocator()
+    {
+        for (void *slab : slabs)
+            ::free(slab);
+    }
+
+public:
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    static SlabAllocator *create()
+    {
+        return new SlabAllocator();
+    }
+
+    // Drops the owner's reference; outstanding blocks stay valid
+    void release()
+    {
+        bool last;
+        {
+            lock_guard<mutex> lock(mtx);
+            orphaned = true;
+            last = liveBlocks == 0;
+        }
+        if (last)
+            delete this;
+    }
+
+    void *allocate(size_t bytes)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto &sizes = classSizes();
+        auto it = lower_bound(sizes.begin(), sizes.end(), bytes);
+        void *block;
+
+        if (it == sizes.end())
+        {
+            block = allocateLarge(bytes);
+        }
+        else
+        {
+            uint32_t index = it - sizes.begin();
+            SizeClass &sc = classes[index];
+            block = allocateFrom(sc, index);
+            sc.stats.blocksInUse++;
+            sc.stats.requestedBytes += bytes;
+        }
+        liveBlocks++;
+        return block;
+    }
+
+    // bytes must match the allocate() call; safe from any thread
+    static void deallocate(void *ptr, size_t bytes)
+    {
+        SlabHeader *header = headerOf(ptr);
+        SlabAllocator *owner = header->owner;
+        if (owner->reclaim(ptr, bytes, header->sizeClass))
+            delete owner;
+    }
+
+    // One row per size class, then one for oversized allocations
+    vector<SlabClassStats> stats()
+    {
+        lock_guard<mutex> lock(mtx);
+        vector<SlabClassStats> result;
+        for (auto &sc : classes)
+            result.push_back(sc.stats);
+        result.push_back(largeStats);
+        return result;
+    }
+};
@@ -0,0 +1,325 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+enum LatencyMetric
+{
+    GET_LATENCY = 0,
+    SET_LATENCY = 1,
+    CLEANUP_LATENCY = 2
+};
+
+enum AccessKind
+{
+    READ_ACCESS = 0,
+    WRITE_ACCESS = 1
+};
+
+// Power-of-two nanosecond buckets: bucket b counts samples in [2^(b-1), 2^b)
+class LatencyHistogram
+{
+private:
+    static constexpr int BUCKETS = 40;
+
+    array<uint64_t, BUCKETS> buckets{};
+    uint64_t total = 0;
+
+public:
+    void record(uint64_t ns)
+    {
+        int bucket = ns ? min(64 - __builtin_clzll(ns), BUCKETS - 1) : 0;
+        buckets[bucket]++;
+        total++;
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int b = 0; b < BUCKETS; b++)
+            buckets[b] += other.buckets[b];
+        total += other.total;
+    }
+
+    uint64_t count() const
+    {
+        return total;
+    }
+
+    // Upper bound of the bucket holding the p-th quantile, p in [0, 1]
+    uint64_t percentile(double p) const
+    {
+        uint64_t rank = ceil(p * total);
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++)
+        {
+            seen += buckets[b];
+            if (seen >= max<uint64_t>(rank, 1))
+                return 1ull << b;
+        }
+        return 0;
+    }
+};
+
+struct HotKey
+{
+    string key;
+    uint64_t count; // estimated accesses, sample counts scaled by the rate
+    uint64_t error; // overestimate bound inherited from the evicted slot
+};
+
+// Space-saving top-k: a full table replaces its smallest counter, so any key
+// more frequent than 1/capacity of the stream is guaranteed to be present
+class SpaceSaving
+{
+private:
+    struct Slot
+    {
+        size_t hash;
+        string key;
+        uint64_t count;
+        uint64_t error;
+    };
+
+    size_t capacity;
+    vector<Slot> slots;
+    hash<string_view> hasher;
+
+public:
+    explicit SpaceSaving(size_t capacity) : capacity(capacity) {}
+
+    void add(string_view key)
+    {
+        size_t hash = hasher(key);
+        for (auto &slot : slots)
+        {
+            if (slot.hash == hash && slot.key == key)
+            {
+                slot.count++;
+                return;
+            }
+        }
+
+        if (slots.size() < capacity)
+        {
+            slots.push_back({hash, string(key), 1, 0});
+            return;
+        }
+
+        auto &smallest = *min_element(slots.begin(), slots.end(), [](const Slot &a, const Slot &b)
+                                      { return a.count < b.count; });
+        smallest.hash = hash;
+        smallest.key.assign(key.data(), key.size());
+        smallest.error = smallest.count;
+        smallest.count++;
+    }
+
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (auto &slot : slots)
+            f(slot.key, slot.count, slot.error);
+    }
+};
+
+struct StatsSnapshot
+{
+    uint32_t sampleRate = 0;
+    vector<HotKey> hotReads, hotWrites;
+    LatencyHistogram latency[3];
+    size_t expiryQueueDepth = 0;
+    size_t keys = 0;
+
+    string format() const
+    {
+        ostringstream out;
+        out << "keys " << keys << ", expiry queue " << expiryQueueDepth << ", sampling 1/" << sampleRate << "\n";
+
+        const char *names[] = {"get", "set", "cleanup"};
+        for (int m = 0; m < 3; m++)
+        {
+            auto &h = latency[m];
+            out << names[m] << " latency (ns, " << h.count() << " samples): p50 <" << h.percentile(0.5)
+                << " p99 <" << h.percentile(0.99) << " p999 <" << h.percentile(0.999) << "\n";
+        }
+
+        auto list = [&](const char *title, const vector<HotKey> &keys)
+        {
+            out << title << ":";
+            for (auto &hot : keys)
+                out << " " << hot.key << "=" << hot.count << "(+-" << hot.error << ")";
+            out << "\n";
+        };
+        list("hot reads", hotReads);
+        list("hot writes", hotWrites);
+        return out.str();
+    }
+};
+
+// Sampled instrumentation. The fast path is a thread_local countdown keyed
+// by the collector, so it writes nothing shared; only about one op in
+// sampleRate takes its stripe lock to time itself and count its key.
+// Stripes are assigned to threads round-robin, so a sampled op almost never
+// waits and nothing has to outlive its thread.
+class StatsCollector
+{
+private:
+    static constexpr size_t STRIPES = 16;
+    static constexpr size_t TOP_K = 64;
+    // Keeps the randomised gaps below within 32 bits
+    static constexpr uint32_t MAX_SAMPLE_RATE = 1u << 30;
+
+    // A thread's sampling state for one collector. A thread keeps a few,
+    // picked by collector id; when two collectors collide the newcomer
+    // takes over the slot with a fresh random gap, and the takeover itself
+    // is sampled with probability 1/rate, so the rate still holds.
+    struct Sampler
+    {
+        uint64_t owner = 0;
+        uint32_t countdown = 0;
+        uint32_t rng = 0;
+    };
+    static constexpr size_t SAMPLERS = 4;
+
+    struct alignas(64) Stripe
+    {
+        mutex mtx;
+        SpaceSaving hot[2] = {SpaceSaving(TOP_K), SpaceSaving(TOP_K)};
+        LatencyHistogram latency[3];
+    };
+
+    const uint64_t id;
+    atomic<uint32_t> sampleRate;
+    Stripe stripes[STRIPES];
+
+    static uint64_t nextId()
+    {
+        static atomic<uint64_t> ids{0};
+        return ++ids;
+    }
+
+    static uint32_t nextRandom(Sampler &state)
+    {
+        state.rng ^= state.rng << 13;
+        state.rng ^= state.rng >> 17;
+        state.rng ^= state.rng << 5;
+        return state.rng;
+    }
+
+    // Randomised gaps averaging rate ops, so periodic workloads don't alias
+    static uint32_t nextGap(Sampler &state, uint32_t rate)
+    {
+        return 1 + nextRandom(state) % (2 * rate - 1);
+    }
+
+    // The gap is over, was drawn for a rate since lowered, or belongs to
+    // another collector
+    bool endGap(Sampler &state, uint32_t rate)
+    {
+        if (state.owner != id)
+        {
+            static atomic<uint32_t> seeds{0};
+            if (!state.rng)
+                state.rng = 0x9E3779B9u * (seeds.fetch_add(1, memory_order_relaxed) + 1) | 1;
+            state.owner = id;
+            state.countdown = nextGap(state, rate);
+            return nextRandom(state) % rate == 0;
+        }
+        bool sample = state.countdown <= 1;
+        state.countdown = nextGap(state, rate);
+        return sample;
+    }
+
+    Stripe &local()
+    {
+        static atomic<size_t> nextStripe{0};
+        static thread_local size_t index = nextStripe++ % STRIPES;
+        return stripes[index];
+    }
+
+    static vector<HotKey> top(map<string, pair<uint64_t, uint64_t>> &merged, uint32_t rate, size_t k)
+    {
+        vector<HotKey> result;
+        for (auto &[key, counts] : merged)
+            result.push_back({key, counts.first * rate, counts.second * rate});
+        sort(result.begin(), result.end(), [](const HotKey &a, const HotKey &b)
+             { return a.count > b.count; });
+        if (result.size() > k)
+            result.resize(k);
+        return result;
+    }
+
+public:
+    explicit StatsCollector(uint32_t sampleRate = 64) : id(nextId()), sampleRate(min(sampleRate, MAX_SAMPLE_RATE)) {}
+
+    // 0 disables sampling; rates above 2^30 are clamped
+    void setSampleRate(uint32_t rate)
+    {
+        sampleRate.store(min(rate, MAX_SAMPLE_RATE), memory_order_relaxed);
+    }
+
+    bool shouldSample()
+    {
+        uint32_t rate = sampleRate.load(memory_order_relaxed);
+        if (!rate)
+            return false;
+
+        static thread_local Sampler samplers[SAMPLERS];
+        Sampler &state = samplers[id % SAMPLERS];
+        // Mid-gap: countdown in [2, 2 * rate), as one unsigned compare
+        if (state.owner == id && state.countdown - 2 < 2 * rate - 2)
+        {
+            state.countdown--;
+            return false;
+        }
+        return endGap(state, rate);
+    }
+    void record(LatencyMetric metric, chrono::steady_clock::duration elapsed)
+    {
+        Stripe &stripe = local();
+        lock_guard<mutex> lock(stripe.mtx);
+        stripe.latency[metric].record(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+    }
+
+    void record(AccessKind kind, string_view key, LatencyMetric metric, chrono::steady_clock::duration elapsed)
+    {
+        Stripe &stripe = local();
+        lock_guard<mutex> lock(stripe.mtx);
+        stripe.hot[kind].add(key);
+        stripe.latency[metric].record(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+    }
+
+    // Keys are counted without timing, e.g. per key of a batch
+    void recordAccess(AccessKind kind, string_view key)
+    {
+        Stripe &stripe = local();
+        lock_guard<mutex> lock(stripe.mtx);
+        stripe.hot[kind].add(key);
+    }
+
+    // Merges every stripe; the caller fills in the store-level fields
+    StatsSnapshot snapshot(size_t topK = 10)
+    {
+        StatsSnapshot result;
+        uint32_t rate = max<uint32_t>(sampleRate.load(memory_order_relaxed), 1);
+        result.sampleRate = rate;
+
+        map<string, pair<uint64_t, uint64_t>> merged[2];
+        for (auto &stripe : stripes)
+        {
+            lock_guard<mutex> lock(stripe.mtx);
+            for (int kind = 0; kind < 2; kind++)
+                stripe.hot[kind].forEach([&](const string &key, uint64_t count, uint64_t error)
+                                         {
+                    auto &slot = merged[kind][key];
+                    slot.first += count;
+                    slot.second += error; });
+            for (int m = 0; m < 3; m++)
+                result.latency[m].merge(stripe.latency[m]);
+        }
+
+        result.hotReads = top(merged[READ_ACCESS], rate, topK);
+        result.hotWrites = top(merged[WRITE_ACCESS], rate, topK);
+        return result;
+    }
+};
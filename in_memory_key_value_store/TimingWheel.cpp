@@ -0,0 +1,222 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+// Intrusive hook: anything scheduled on a TimingWheel embeds one of these
+struct TimerNode
+{
+    TimerNode *prev = nullptr;
+    TimerNode *next = nullptr;
+    uint64_t deadlineTick = 0;
+    uint8_t level = 0;
+
+    bool scheduled() const
+    {
+        return next != nullptr;
+    }
+};
+
+// Hierarchical hashed timing wheel: 4 levels of 256 slots each. Level l slot
+// covers 256^l ticks; timers cascade down a level as their slot comes due, so
+// schedule and cancel are O(1) and a tick reaps its whole slot in one batch.
+class TimingWheel
+{
+private:
+    using Clock = chrono::steady_clock;
+
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint64_t SLOTS = 1ull << SLOT_BITS;
+    static constexpr uint64_t MASK = SLOTS - 1;
+    static constexpr uint64_t MAX_SPAN = 1ull << (LEVELS * SLOT_BITS);
+
+    Clock::duration resolution;
+    Clock::time_point origin;
+    uint64_t currentTick = 0;
+
+    size_t count = 0;
+    size_t levelCount[LEVELS] = {};
+
+    // Circular doubly linked lists with sentinel heads
+    TimerNode slots[LEVELS][SLOTS];
+
+    static void link(TimerNode &head, TimerNode *node)
+    {
+        node->prev = head.prev;
+        node->next = &head;
+        head.prev->next = node;
+        head.prev = node;
+    }
+
+    static void unlink(TimerNode *node)
+    {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node->next = nullptr;
+    }
+
+    static bool isEmpty(const TimerNode &head)
+    {
+        return head.next == &head;
+    }
+
+    uint64_t tickFloor(Clock::time_point tp) const
+    {
+        return tp <= origin ? 0 : (tp - origin) / resolution;
+    }
+
+    uint64_t tickCeil(Clock::time_point tp) const
+    {
+        return tp <= origin ? 0 : (tp - origin + resolution - Clock::duration(1)) / resolution;
+    }
+
+    void place(TimerNode *node)
+    {
+        // Timers further out than the wheel spans park in the top level and
+        // are re-placed with their real deadline when that slot cascades
+        uint64_t deadline = max(node->deadlineTick, currentTick);
+        uint64_t effective = min(deadline, currentTick + MAX_SPAN - 1);
+        uint64_t delta = effective - currentTick;
+
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1))))
+            level++;
+
+        node->level = level;
+        levelCount[level]++;
+        link(slots[level][(effective >> (SLOT_BITS * level)) & MASK], node);
+    }
+
+    void cascade(int level, uint64_t idx)
+    {
+        TimerNode &head = slots[level][idx];
+        while (!isEmpty(head))
+        {
+            TimerNode *node = head.next;
+            unlink(node);
+            levelCount[level]--;
+            place(node);
+        }
+    }
+
+public:
+    TimingWheel(Clock::duration resolution = chrono::milliseconds(1))
+        : resolution(resolution), origin(Clock::now())
+    {
+        for (auto &level : slots)
+            for (auto &head : level)
+                head.prev = head.next = &head;
+    }
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    // Schedules (or reschedules) node to fire no earlier than deadline
+    void schedule(TimerNode *node, Clock::time_point deadline)
+    {
+        cancel(node);
+        node->deadlineTick = max(tickCeil(deadline), currentTick + 1);
+        place(node);
+        count++;
+    }
+
+    void cancel(TimerNode *node)
+    {
+        if (!node->scheduled())
+            return;
+        levelCount[node->level]--;
+        count--;
+        unlink(node);
+    }
+
+    // Fires every timer due by now; each node is unlinked before onExpired sees it
+    template <typename F>
+    void advance(Clock::time_point now, F onExpired)
+    {
+        uint64_t target = tickFloor(now);
+
+        while (currentTick < target)
+        {
+            if (count == 0)
+            {
+                currentTick = target;
+                break;
+            }
+
+            // With the low levels empty nothing happens until the next
+            // cascade of the lowest occupied level, so jump straight there
+            int lowest = 0;
+            while (levelCount[lowest] == 0)
+                lowest++;
+            if (lowest > 0)
+            {
+                uint64_t span = 1ull << (SLOT_BITS * lowest);
+                currentTick = min(currentTick | (span - 1), target - 1);
+            }
+
+            currentTick++;
+
+            int top = 0;
+            while (top < LEVELS - 1 && (currentTick & ((1ull << (SLOT_BITS * (top + 1))) - 1)) == 0)
+                top++;
+            for (int level = top; level > 0; level--)
+                cascade(level, (currentTick >> (SLOT_BITS * level)) & MASK);
+
+            TimerNode &head = slots[0][currentTick & MASK];
+            while (!isEmpty(head))
+            {
+                TimerNode *node = head.next;
+                unlink(node);
+                levelCount[0]--;
+                count--;
+                onExpired(node);
+            }
+        }
+    }
+
+    // Earliest time advance() has work to do: a due slot or a pending cascade
+    Clock::time_point nextExpiry() const
+    {
+        if (count == 0)
+            return Clock::time_point::max();
+
+        uint64_t best = numeric_limits<uint64_t>::max();
+
+        if (levelCount[0])
+        {
+            for (uint64_t i = 1; i <= SLOTS; i++)
+            {
+                if (!isEmpty(slots[0][(currentTick + i) & MASK]))
+                {
+                    best = currentTick + i;
+                    break;
+                }
+            }
+        }
+
+        for (int level = 1; level < LEVELS; level++)
+        {
+            if (!levelCount[level])
+                continue;
+            int shift = SLOT_BITS * level;
+            for (uint64_t i = 1; i <= SLOTS; i++)
+            {
+                uint64_t boundary = ((currentTick >> shift) + i) << shift;
+                if (!isEmpty(slots[level][(boundary >> shift) & MASK]))
+                {
+                    best = min(best, boundary);
+                    break;
+                }
+            }
+        }
+
+        return origin + resolution * best;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+};
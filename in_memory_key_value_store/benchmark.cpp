@@ -0,0 +1,540 @@
+#include "bits/stdc++.h"
+#include "KeyValueStore.cpp"
+
+using namespace std;
+
+// Build: g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+// Usage: ./benchmark [scenario] [durationMs] [maxKeys]
+
+struct BenchConfig
+{
+    int durationMs = 300;
+    int keyCount = 100000;
+    int maxKeys = 10000000;
+};
+
+static vector<string> makeKeys(int n)
+{
+    vector<string> keys;
+    keys.reserve(n);
+    for (int i = 0; i < n; i++)
+        keys.push_back("key" + to_string(i));
+    return keys;
+}
+
+// 90% get / 10% set over a uniform key space, reports total ops/sec
+template <typename Store>
+static double runMixed(Store &store, const vector<string> &keys, int threads, int durationMs)
+{
+    atomic<bool> go{false}, done{false};
+    atomic<long long> totalOps{0};
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            mt19937 rng(t + 1);
+            uniform_int_distribution<int> pick(0, keys.size() - 1);
+            long long ops = 0;
+
+            while (!go.load())
+                this_thread::yield();
+
+            while (!done.load(memory_order_relaxed))
+            {
+                const string &key = keys[pick(rng)];
+                if (ops % 10 == 0)
+                    store.set(key, "v", chrono::seconds(60));
+                else
+                    store.get(key);
+                ops++;
+            }
+            totalOps += ops; });
+    }
+
+    auto start = chrono::steady_clock::now();
+    go = true;
+    this_thread::sleep_for(chrono::milliseconds(durationMs));
+    done = true;
+    for (auto &w : workers)
+        w.join();
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return totalOps.load() / secs;
+}
+
+static void benchShards(const BenchConfig &cfg)
+{
+    auto keys = makeKeys(cfg.keyCount);
+    vector<int> threadCounts = {1, 2, 4, 8, 16, 32};
+
+    cout << "shards\\threads";
+    for (int t : threadCounts)
+        cout << "\t" << t;
+    cout << "\t(Mops/s)" << endl;
+
+    for (size_t shards : {1, 8, 64})
+    {
+        KeyValueStore<> store(shards);
+        for (auto &key : keys)
+            store.set(key, "v", chrono::seconds(60));
+
+        cout << shards;
+        for (int t : threadCounts)
+            cout << "\t" << fixed << setprecision(2) << runMixed(store, keys, t, cfg.durationMs) / 1e6 << flush;
+        cout << endl;
+    }
+}
+
+// Single-threaded ns/op for set and get as the key count grows
+template <typename Map>
+static void benchBackendAt(const string &name, int n)
+{
+    auto keys = makeKeys(n);
+    KeyValueStore<Map> store;
+    store.reserve(n);
+
+    auto start = chrono::steady_clock::now();
+    for (auto &key : keys)
+        store.set(key, "value", chrono::hours(1));
+    double setNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+    mt19937 rng(42);
+    shuffle(keys.begin(), keys.end(), rng);
+    size_t hits = 0;
+    start = chrono::steady_clock::now();
+    for (auto &key : keys)
+        hits += store.get(key) != NA;
+    double getNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+
+    cout << name << "\t" << n << "\t" << fixed << setprecision(1) << setNs << "\t" << getNs
+         << (hits == keys.size() ? "" : "\t(missing keys!)") << endl;
+}
+
+static void benchBackend(const BenchConfig &cfg)
+{
+    cout << "backend\tkeys\tset ns/op\tget ns/op" << endl;
+    for (int n = 100000; n <= cfg.maxKeys; n *= 10)
+    {
+        benchBackendAt<TreeBackend>("map", n);
+        benchBackendAt<FlatBackend>("flat", n);
+    }
+}
+
+// Key ranks drawn from a Zipf(s) distribution over [0, n)
+static vector<int> zipfTrace(int n, double s, size_t length, uint32_t seed)
+{
+    vector<double> cdf(n);
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        cdf[i] = sum += 1.0 / pow(i + 1, s);
+
+    mt19937 rng(seed);
+    uniform_real_distribution<double> u(0, sum);
+    vector<int> trace(length);
+    for (auto &rank : trace)
+        rank = lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+    return trace;
+}
+
+// Cache-aside replay: get, and set on a miss; returns {hits, ops/sec}
+template <typename Store>
+static pair<size_t, double> replay(Store &store, const vector<string> &keys, const vector<int> &trace, int threads)
+{
+    atomic<size_t> hits{0};
+    vector<thread> workers;
+    string value(32, 'x');
+
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            size_t localHits = 0;
+            for (size_t i = t; i < trace.size(); i += threads)
+            {
+                const string &key = keys[trace[i]];
+                if (store.view(key))
+                    localHits++;
+                else
+                    store.set(key, value, chrono::hours(1));
+            }
+            hits += localHits; });
+    }
+    for (auto &w : workers)
+        w.join();
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return {hits.load(), trace.size() / secs};
+}
+
+static void benchEviction(const BenchConfig &cfg)
+{
+    const int universe = cfg.keyCount * 10;
+    auto keys = makeKeys(universe);
+    auto trace = zipfTrace(universe, 0.99, universe * 2, 7);
+
+    // Budget for roughly 10% of the key space
+    size_t budget = Entry::footprint(keys[universe / 2].size(), 32) * universe / 10;
+
+    cout << "zipf(0.99) over " << universe << " keys, budget " << budget / 1024 << " KiB" << endl;
+    cout << "policy\tthreads\thit ratio\tMops/s" << endl;
+
+    vector<pair<string, EvictionPolicyType>> policies = {
+        {"lru", LRU}, {"lfu", SAMPLED_LFU}, {"w-tinylfu", W_TINY_LFU}};
+
+    for (auto &[name, type] : policies)
+    {
+        for (int threads : {1, 8})
+        {
+            KeyValueStore<> store(8, budget, type);
+            auto [hits, opsPerSec] = replay(store, keys, trace, threads);
+            cout << name << "\t" << threads << "\t" << fixed << setprecision(3) << double(hits) / trace.size()
+                 << "\t" << setprecision(2) << opsPerSec / 1e6 << endl;
+        }
+    }
+}
+
+// Snapshot maxKeys entries, then time a cold store restoring them
+static void benchRestore(const BenchConfig &cfg)
+{
+    string dir = "/tmp/kv_restore_bench";
+    for (uint64_t gen : logGenerations(dir))
+        ::unlink(AppendLog::pathFor(dir, gen).c_str());
+    ::unlink((dir + "/snapshot.bin").c_str());
+
+    PersistenceOptions options;
+    options.snapshotInterval = chrono::seconds(0);
+
+    {
+        KeyValueStore<> store(64);
+        store.enablePersistence(dir, options);
+        store.reserve(cfg.maxKeys);
+        for (int i = 0; i < cfg.maxKeys; i++)
+            store.set("key" + to_string(i), "value" + to_string(i), chrono::hours(1));
+
+        auto start = chrono::steady_clock::now();
+        store.snapshot();
+        cout << "snapshot of " << cfg.maxKeys << " keys: "
+             << chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s" << endl;
+    }
+
+    KeyValueStore<> store(64);
+    store.reserve(cfg.maxKeys);
+    auto start = chrono::steady_clock::now();
+    store.enablePersistence(dir, options);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "restored " << store.size() << " keys with " << options.loaderThreads << " loader threads: "
+         << secs << "s (" << fixed << setprecision(2) << store.size() / secs / 1e6 << " Mkeys/s)" << endl;
+}
+
+// ns/key of mget/mset at increasing batch sizes against one call per key
+static void benchBatch(const BenchConfig &cfg)
+{
+    auto keys = makeKeys(cfg.keyCount);
+    KeyValueStore<> store(8);
+    store.reserve(keys.size());
+    for (auto &key : keys)
+        store.set(key, "value", chrono::hours(1));
+
+    mt19937 rng(42);
+    shuffle(keys.begin(), keys.end(), rng);
+
+    auto nsPerKey = [&](auto op)
+    {
+        auto start = chrono::steady_clock::now();
+        op();
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / keys.size();
+    };
+
+    double getNs = nsPerKey([&]()
+                            { for (auto &key : keys) store.get(key); });
+    double setNs = nsPerKey([&]()
+                            { for (auto &key : keys) store.set(key, "value", chrono::hours(1)); });
+    cout << "single\t-\t" << fixed << setprecision(1) << getNs << "\t" << setNs << endl;
+
+    cout << "batch\tsize\tmget ns/key\tmset ns/key" << endl;
+    for (size_t size : {1, 4, 16, 64, 256, 1024})
+    {
+        vector<vector<string>> batches;
+        vector<vector<pair<string, string>>> items;
+        for (size_t i = 0; i < keys.size(); i += size)
+        {
+            batches.emplace_back(keys.begin() + i, keys.begin() + min(i + size, keys.size()));
+            items.emplace_back();
+            for (auto &key : batches.back())
+                items.back().emplace_back(key, "value");
+        }
+
+        double mgetNs = nsPerKey([&]()
+                                 { for (auto &batch : batches) store.mget(batch); });
+        double msetNs = nsPerKey([&]()
+                                 { for (auto &batch : items) store.mset(batch, chrono::hours(1)); });
+        cout << "batch\t" << size << "\t" << mgetNs << "\t" << msetNs << endl;
+    }
+}
+
+// Overwrite churn with mixed value sizes, then slab usage per size class
+static void benchMemory(const BenchConfig &cfg)
+{
+    auto keys = makeKeys(cfg.keyCount);
+    KeyValueStore<> store(8);
+    store.reserve(keys.size());
+
+    mt19937 rng(42);
+    uniform_int_distribution<int> valueSize(8, 1024);
+    string payload(1024, 'x');
+
+    const int rounds = 5;
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++)
+        for (auto &key : keys)
+            store.set(key, payload.substr(0, valueSize(rng)), chrono::hours(1));
+    double setNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (keys.size() * rounds);
+    EpochDomain::global().collect();
+
+    cout << "set ns/op with churn: " << fixed << setprecision(1) << setNs << endl;
+    cout << "block\tslabs\tin use\tfree\tKiB in use\tfragmentation" << endl;
+
+    SlabClassStats total;
+    for (auto &stats : store.memoryStats())
+    {
+        total += stats;
+        if (!stats.slabs)
+            continue;
+        cout << (stats.blockSize ? to_string(stats.blockSize) : "large") << "\t" << stats.slabs << "\t"
+             << stats.blocksInUse << "\t" << stats.blocksFree << "\t" << stats.bytesInUse() / 1024
+             << "\t" << setprecision(3) << stats.fragmentation() << endl;
+    }
+    cout << "total\t" << total.slabs << "\t" << total.blocksInUse << "\t" << total.blocksFree << "\t"
+         << total.requestedBytes / 1024 << "\t" << total.fragmentation() << endl;
+}
+
+// Throughput with sampling off vs on over a Zipf trace, then the report
+static void benchStats(const BenchConfig &cfg)
+{
+    auto keys = makeKeys(cfg.keyCount);
+    auto trace = zipfTrace(cfg.keyCount, 0.99, cfg.keyCount * 10, 11);
+    KeyValueStore<> store(8);
+    for (auto &key : keys)
+        store.set(key, "value", chrono::hours(1));
+
+    // Paired runs, alternating which setting goes first so drift hits both
+    // equally. One pair swings by a few percent, so report the median.
+    const int pairs = 15;
+    vector<double> off, on, overhead;
+    replay(store, keys, trace, 1); // warm-up
+    for (int pair = 0; pair < pairs; pair++)
+    {
+        double opsPerSec[2];
+        for (int i = 0; i < 2; i++)
+        {
+            int sampling = (pair + i) % 2;
+            store.setStatsSampleRate(sampling ? 64 : 0);
+            opsPerSec[sampling] = replay(store, keys, trace, 1).second;
+        }
+        off.push_back(opsPerSec[0]);
+        on.push_back(opsPerSec[1]);
+        overhead.push_back((1 - opsPerSec[1] / opsPerSec[0]) * 100);
+    }
+    auto median = [](vector<double> values)
+    {
+        nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    };
+
+    cout << "sampling off\t" << fixed << setprecision(2) << median(off) / 1e6 << " Mops/s" << endl;
+    cout << "sampling 1/64\t" << median(on) / 1e6 << " Mops/s (median overhead " << setprecision(1)
+         << median(overhead) << "% over " << pairs << " pairs, range " << *min_element(overhead.begin(), overhead.end())
+         << " to " << *max_element(overhead.begin(), overhead.end()) << "%)" << endl;
+    cout << store.stats(5).format();
+}
+
+// Threads incrementing a few shared counters three ways: get+set (racy),
+// a CAS retry loop, and incr. Reports throughput and lost increments.
+static void benchRmw(const BenchConfig &cfg)
+{
+    const int counters = 4;
+    auto keys = makeKeys(counters);
+
+    auto run = [&](int threads, auto increment)
+    {
+        KeyValueStore<> store(8);
+        for (auto &key : keys)
+            store.set(key, "0", chrono::hours(1));
+
+        atomic<bool> done{false};
+        atomic<long long> total{0};
+        vector<thread> workers;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t]()
+                                 {
+                long long ops = 0;
+                while (!done.load(memory_order_relaxed))
+                    increment(store, keys[(t + ops++) % counters]);
+                total += ops; });
+        }
+        this_thread::sleep_for(chrono::milliseconds(cfg.durationMs));
+        done = true;
+        for (auto &w : workers)
+            w.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        long long stored = 0;
+        for (auto &key : keys)
+            stored += stoll(store.get(key));
+        return make_pair(total.load() / secs, total.load() - stored);
+    };
+
+    auto getSet = [](KeyValueStore<> &store, const string &key)
+    {
+        store.set(key, to_string(stoll(store.get(key)) + 1), chrono::hours(1));
+    };
+    auto cas = [](KeyValueStore<> &store, const string &key)
+    {
+        while (true)
+        {
+            int64_t value;
+            uint64_t version;
+            {
+                ValueHandle handle = store.view(key);
+                parseInteger(handle.value(), value);
+                version = handle.version();
+            }
+            if (store.compareAndSet(key, version, to_string(value + 1), chrono::hours(1)))
+                return;
+        }
+    };
+    auto incr = [](KeyValueStore<> &store, const string &key)
+    {
+        store.incr(key, 1, chrono::hours(1));
+    };
+
+    cout << "method\tthreads\tMops/s\tlost updates" << endl;
+    for (int threads : {1, 4, 8})
+    {
+        auto report = [&](const char *name, pair<double, long long> result)
+        {
+            cout << name << "\t" << threads << "\t" << fixed << setprecision(2) << result.first / 1e6
+                 << "\t" << result.second << endl;
+        };
+        report("get+set", run(threads, getSet));
+        report("cas", run(threads, cas));
+        report("incr", run(threads, incr));
+    }
+}
+
+// 16 threads read one hot key with a 200ms TTL backed by a 10ms loader:
+// loader calls and worst-case read latency (after a warm-up load) for plain
+// cache-aside vs getOrLoad
+static void benchLoader(const BenchConfig &cfg)
+{
+    const int threads = 16;
+    const auto ttl = chrono::milliseconds(200);
+
+    auto run = [&](auto read)
+    {
+        KeyValueStore<> store;
+        atomic<int> loads{0};
+        auto loader = [&](const string &key)
+        {
+            loads++;
+            this_thread::sleep_for(chrono::milliseconds(10));
+            return "value of " + key;
+        };
+
+        read(store, loader);
+        loads = 0;
+
+        atomic<bool> done{false};
+        atomic<long long> reads{0};
+        vector<Duration> worst(threads);
+        vector<thread> workers;
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t]()
+                                 {
+                while (!done.load(memory_order_relaxed))
+                {
+                    auto start = chrono::steady_clock::now();
+                    read(store, loader);
+                    worst[t] = max(worst[t], chrono::steady_clock::now() - start);
+                    reads++;
+                    this_thread::sleep_for(chrono::microseconds(100));
+                } });
+        }
+        this_thread::sleep_for(chrono::milliseconds(cfg.durationMs));
+        done = true;
+        for (auto &w : workers)
+            w.join();
+        return make_tuple(reads.load(), loads.load(), *max_element(worst.begin(), worst.end()));
+    };
+
+    auto cacheAside = [&](KeyValueStore<> &store, auto &loader)
+    {
+        string value = store.get("hot");
+        if (value == NA)
+            store.set("hot", loader("hot"), ttl);
+    };
+    auto coalesced = [&](KeyValueStore<> &store, auto &loader)
+    {
+        LoadOptions options;
+        options.earlyRefreshBeta = 0;
+        store.getOrLoad("hot", loader, ttl, options);
+    };
+    auto early = [&](KeyValueStore<> &store, auto &loader)
+    {
+        store.getOrLoad("hot", loader, ttl);
+    };
+    auto stale = [&](KeyValueStore<> &store, auto &loader)
+    {
+        LoadOptions options;
+        options.staleWhileRevalidate = chrono::milliseconds(100);
+        store.getOrLoad("hot", loader, ttl, options);
+    };
+
+    cout << "mode\treads\tloads\tworst read ms" << endl;
+    auto report = [](const char *name, tuple<long long, int, Duration> result)
+    {
+        cout << name << "\t" << get<0>(result) << "\t" << get<1>(result) << "\t" << fixed << setprecision(2)
+             << chrono::duration<double, milli>(get<2>(result)).count() << endl;
+    };
+    report("cache-aside", run(cacheAside));
+    report("single-flight", run(coalesced));
+    report("+early refresh", run(early));
+    report("+stale serving", run(stale));
+}
+
+int main(int argc, char **argv)
+{
+    string scenario = argc > 1 ? argv[1] : "shards";
+    BenchConfig cfg;
+    if (argc > 2)
+        cfg.durationMs = stoi(argv[2]);
+    if (argc > 3)
+        cfg.maxKeys = stoi(argv[3]);
+
+    map<string, function<void(const BenchConfig &)>> scenarios = {
+        {"shards", benchShards},
+        {"backend", benchBackend},
+        {"eviction", benchEviction},
+        {"restore", benchRestore},
+        {"batch", benchBatch},
+        {"memory", benchMemory},
+        {"stats", benchStats},
+        {"rmw", benchRmw},
+        {"loader", benchLoader},
+    };
+
+    auto it = scenarios.find(scenario);
+    if (it == scenarios.end())
+    {
+        cout << "unknown scenario: " << scenario << endl;
+        return 1;
+    }
+    it->second(cfg);
+}
@@ -0,0 +1,571 @@
+#include "bits/stdc++.h"
+#include "KeyValueStore.cpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+// Build: g++ -std=c++17 -O2 -pthread server.cpp -o server
+// Usage: ./server [port] [reactors] [shards] [maxBytes]
+//        ./server check    runs protocol checks on a loopback port, exits non-zero on failure
+//
+// Speaks enough RESP for redis-cli and redis-benchmark: GET, SET with EX/PX,
+// DEL, MGET, TTL, plus PING and stub CONFIG/COMMAND replies.
+
+// SET without EX/PX; TTL reports keys this far out as having no expiry
+static const Duration NO_EXPIRY = chrono::hours(24 * 365 * 100);
+
+static bool equalsIgnoreCase(string_view a, string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (toupper(static_cast<unsigned char>(a[i])) != b[i])
+            return false;
+    return true;
+}
+
+// Replies are appended to the connection's output buffer and written once
+// per batch of pipelined requests
+class RespWriter
+{
+private:
+    string &out;
+
+    void line(char prefix, int64_t value)
+    {
+        char buf[24];
+        int n = snprintf(buf, sizeof(buf), "%c%" PRId64 "\r\n", prefix, value);
+        out.append(buf, n);
+    }
+
+public:
+    RespWriter(string &out) : out(out) {}
+
+    void simple(string_view text)
+    {
+        out += '+';
+        out.append(text.data(), text.size());
+        out += "\r\n";
+    }
+
+    void error(string_view text)
+    {
+        out += "-ERR ";
+        out.append(text.data(), text.size());
+        out += "\r\n";
+    }
+
+    void integer(int64_t value)
+    {
+        line(':', value);
+    }
+
+    void bulk(string_view value)
+    {
+        line('$', value.size());
+        out.append(value.data(), value.size());
+        out += "\r\n";
+    }
+
+    void nil()
+    {
+        out += "$-1\r\n";
+    }
+
+    void array(size_t count)
+    {
+        line('*', count);
+    }
+};
+
+// One client socket; buffers live as long as the connection
+struct Connection
+{
+    int fd;
+    vector<char> in = vector<char>(16 * 1024);
+    size_t inLen = 0;
+    string out;
+    size_t outOffset = 0;
+    vector<string_view> args;
+    uint32_t interest = EPOLLIN;
+    bool closing = false;
+
+    explicit Connection(int fd) : fd(fd) {}
+
+    ~Connection()
+    {
+        ::close(fd);
+    }
+};
+
+class Reactor
+{
+private:
+    enum ParseResult
+    {
+        PARSED,
+        INCOMPLETE,
+        INVALID
+    };
+
+    static constexpr size_t MAX_REQUEST = 512 * 1024 * 1024;
+    // The input buffer only grows to fit one request larger than it
+    static constexpr size_t MAX_BUFFERED = MAX_REQUEST + 64 * 1024;
+    // Past this much unsent output, stop reading until the client catches up
+    static constexpr size_t OUT_HIGH_WATER = 4 * 1024 * 1024;
+
+    KeyValueStore<> &store;
+    int epfd;
+    int listenFd;
+    unordered_map<int, unique_ptr<Connection>> connections;
+    thread worker;
+
+    // Finds "\r\n" at or after pos; returns its offset or npos
+    static size_t findCrlf(const char *data, size_t len, size_t pos)
+    {
+        for (size_t i = pos; i + 1 < len; i++)
+            if (data[i] == '\r' && data[i + 1] == '\n')
+                return i;
+        return string::npos;
+    }
+
+    // Parses one request from data into args (views into data)
+    static ParseResult parse(const char *data, size_t len, size_t &consumed, vector<string_view> &args)
+    {
+        args.clear();
+        if (len == 0)
+            return INCOMPLETE;
+
+        if (data[0] != '*')
+        {
+            // Inline command: space separated, terminated by \n
+            const char *nl = static_cast<const char *>(memchr(data, '\n', len));
+            if (!nl)
+                return len > MAX_REQUEST ? INVALID : INCOMPLETE;
+            size_t end = nl - data;
+            consumed = end + 1;
+            if (end && data[end - 1] == '\r')
+                end--;
+            for (size_t i = 0; i < end;)
+            {
+                while (i < end && (data[i] == ' ' || data[i] == '\t'))
+                    i++;
+                size_t start = i;
+                while (i < end && data[i] != ' ' && data[i] != '\t')
+                    i++;
+                if (i > start)
+                    args.emplace_back(data + start, i - start);
+            }
+            return PARSED;
+        }
+
+        size_t eol = findCrlf(data, len, 1);
+        if (eol == string::npos)
+            return INCOMPLETE;
+        int64_t count;
+        if (!parseInteger(string_view(data + 1, eol - 1), count) || count < 0 || count > 1024 * 1024)
+            return INVALID;
+
+        size_t pos = eol + 2;
+        for (int64_t i = 0; i < count; i++)
+        {
+            if (pos >= len)
+                return INCOMPLETE;
+            if (data[pos] != '$')
+                return INVALID;
+            eol = findCrlf(data, len, pos + 1);
+            if (eol == string::npos)
+                return INCOMPLETE;
+            int64_t size;
+            if (!parseInteger(string_view(data + pos + 1, eol - pos - 1), size) || size < 0 || size_t(size) > MAX_REQUEST)
+                return INVALID;
+            pos = eol + 2;
+            if (pos + size + 2 > len)
+                return INCOMPLETE;
+            args.emplace_back(data + pos, size);
+            pos += size + 2;
+        }
+        consumed = pos;
+        return PARSED;
+    }
+
+    void execute(Connection &conn)
+    {
+        auto &args = conn.args;
+        RespWriter reply(conn.out);
+        if (args.empty())
+            return;
+        string_view cmd = args[0];
+
+        if (equalsIgnoreCase(cmd, "GET") && args.size() == 2)
+        {
+            ValueHandle handle = store.view(args[1]);
+            if (handle)
+                reply.bulk(handle.value());
+            else
+                reply.nil();
+        }
+        else if (equalsIgnoreCase(cmd, "SET") && (args.size() == 3 || args.size() == 5))
+        {
+            Duration ttl = NO_EXPIRY;
+            if (args.size() == 5)
+            {
+                int64_t amount;
+                bool seconds = equalsIgnoreCase(args[3], "EX");
+                if (!seconds && !equalsIgnoreCase(args[3], "PX"))
+                    return reply.error("syntax error");
+                // The deadline, now + ttl, must still fit the clock
+                Duration unit = seconds ? Duration(chrono::seconds(1)) : Duration(chrono::milliseconds(1));
+                auto longest = chrono::steady_clock::time_point::max() - chrono::steady_clock::now();
+                if (!parseInteger(args[4], amount) || amount <= 0 || amount > longest / unit)
+                    return reply.error("invalid expire time in 'set' command");
+                ttl = unit * amount;
+            }
+            store.set(args[1], args[2], ttl);
+            reply.simple("OK");
+        }
+        else if (equalsIgnoreCase(cmd, "DEL") && args.size() >= 2)
+        {
+            int64_t removed = 0;
+            for (size_t i = 1; i < args.size(); i++)
+                removed += store.del(args[i]);
+            reply.integer(removed);
+        }
+        else if (equalsIgnoreCase(cmd, "MGET") && args.size() >= 2)
+        {
+            reply.array(args.size() - 1);
+            for (size_t i = 1; i < args.size(); i++)
+            {
+                ValueHandle handle = store.view(args[i]);
+                if (handle)
+                    reply.bulk(handle.value());
+                else
+                    reply.nil();
+            }
+        }
+        else if (equalsIgnoreCase(cmd, "TTL") && args.size() == 2)
+        {
+            ValueHandle handle = store.view(args[1]);
+            if (!handle)
+                return reply.integer(-2);
+            auto remaining = handle.expiry() - chrono::steady_clock::now();
+            if (remaining > NO_EXPIRY / 2)
+                return reply.integer(-1);
+            reply.integer((chrono::duration_cast<chrono::milliseconds>(remaining).count() + 500) / 1000);
+        }
+        else if (equalsIgnoreCase(cmd, "PING"))
+        {
+            if (args.size() > 1)
+                reply.bulk(args[1]);
+            else
+                reply.simple("PONG");
+        }
+        else if (equalsIgnoreCase(cmd, "CONFIG") || equalsIgnoreCase(cmd, "COMMAND"))
+        {
+            // redis-benchmark and redis-cli probe these on connect
+            reply.array(0);
+        }
+        else if (equalsIgnoreCase(cmd, "QUIT"))
+        {
+            reply.simple("OK");
+            conn.closing = true;
+        }
+        else
+        {
+            reply.error("unknown command or wrong number of arguments");
+        }
+    }
+
+    static bool backlogged(const Connection &conn)
+    {
+        return conn.out.size() - conn.outOffset > OUT_HIGH_WATER;
+    }
+
+    // Reads while the output is under the high-water mark, writes while
+    // any is pending
+    void updateInterest(Connection &conn)
+    {
+        uint32_t events = (backlogged(conn) ? 0u : uint32_t(EPOLLIN)) |
+                          (conn.outOffset < conn.out.size() ? uint32_t(EPOLLOUT) : 0u);
+        if (conn.interest == events)
+            return;
+        conn.interest = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.ptr = &conn;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+
+    // Returns false when the connection should be dropped
+    bool flush(Connection &conn)
+    {
+        while (conn.outOffset < conn.out.size())
+        {
+            ssize_t n = ::send(conn.fd, conn.out.data() + conn.outOffset, conn.out.size() - conn.outOffset, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN)
+                    return false;
+                updateInterest(conn);
+                return true;
+            }
+            conn.outOffset += n;
+        }
+        conn.out.clear();
+        conn.outOffset = 0;
+        updateInterest(conn);
+        return !conn.closing;
+    }
+
+    // Runs the complete requests already buffered, until the output backs up
+    void process(Connection &conn)
+    {
+        size_t pos = 0;
+        while (!conn.closing && !backlogged(conn))
+        {
+            size_t consumed = 0;
+            ParseResult result = parse(conn.in.data() + pos, conn.inLen - pos, consumed, conn.args);
+            if (result == INCOMPLETE)
+                break;
+            if (result == INVALID)
+            {
+                RespWriter(conn.out).error("Protocol error");
+                conn.closing = true;
+                break;
+            }
+            execute(conn);
+            pos += consumed;
+        }
+
+        if (pos)
+        {
+            memmove(conn.in.data(), conn.in.data() + pos, conn.inLen - pos);
+            conn.inLen -= pos;
+        }
+    }
+
+    // Alternates reads with running the requests they complete, so pipelined
+    // input is bounded by the largest request, then writes the replies at
+    // once. Leaves the socket unread while the output is backlogged.
+    bool onReadable(Connection &conn)
+    {
+        while (true)
+        {
+            process(conn);
+            if (conn.closing)
+                break;
+            if (backlogged(conn))
+            {
+                // Carry on with what is buffered if the socket takes it all
+                if (!flush(conn))
+                    return false;
+                if (backlogged(conn))
+                    return true;
+                continue;
+            }
+
+            if (conn.inLen == conn.in.size())
+            {
+                if (conn.in.size() >= MAX_BUFFERED)
+                {
+                    RespWriter(conn.out).error("Protocol error: request too large");
+                    conn.closing = true;
+                    break;
+                }
+                conn.in.resize(min(conn.in.size() * 2, MAX_BUFFERED));
+            }
+            ssize_t n = ::read(conn.fd, conn.in.data() + conn.inLen, conn.in.size() - conn.inLen);
+            if (n == 0)
+                return false;
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN)
+                    break;
+                return false;
+            }
+            conn.inLen += n;
+        }
+        return flush(conn);
+    }
+
+    void accept()
+    {
+        while (true)
+        {
+            int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            auto conn = make_unique<Connection>(fd);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.ptr = conn.get();
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+            connections[fd] = std::move(conn);
+        }
+    }
+
+    void run()
+    {
+        epoll_event events[256];
+        while (true)
+        {
+            int n = epoll_wait(epfd, events, 256, -1);
+            for (int i = 0; i < n; i++)
+            {
+                if (!events[i].data.ptr)
+                {
+                    accept();
+                    continue;
+                }
+
+                Connection &conn = *static_cast<Connection *>(events[i].data.ptr);
+                bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                bool resumed = false;
+                if (alive && (events[i].events & EPOLLOUT))
+                {
+                    bool wasBacklogged = backlogged(conn);
+                    alive = flush(conn);
+                    // Requests left buffered while backlogged get no EPOLLIN
+                    resumed = wasBacklogged && !backlogged(conn);
+                }
+                if (alive && ((events[i].events & EPOLLIN) || resumed))
+                    alive = onReadable(conn);
+                if (!alive)
+                    connections.erase(conn.fd);
+            }
+        }
+    }
+
+public:
+    // Every reactor binds its own SO_REUSEPORT listener so the kernel
+    // spreads connections across them without a shared accept queue
+    Reactor(KeyValueStore<> &store, uint16_t port) : store(store)
+    {
+        listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(listenFd, 1024) < 0)
+            throw system_error(errno, generic_category(), "listen on port " + to_string(port));
+
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+
+        worker = thread(&Reactor::run, this);
+    }
+
+    // The bound port, for a listener created on port 0
+    uint16_t port() const
+    {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    void join()
+    {
+        worker.join();
+    }
+};
+
+// Sends each request over one connection and compares the reply
+static int check()
+{
+    KeyValueStore<> store(4);
+    Reactor reactor(store, 0);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(reactor.port());
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        throw system_error(errno, generic_category(), "connect");
+    // A reply that never comes fails the check rather than hanging it
+    timeval timeout{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    const string badExpire = "-ERR invalid expire time in 'set' command\r\n";
+    vector<pair<string, string>> cases = {
+        {"SET k v EX 10", "+OK\r\n"},
+        {"GET k", "$1\r\nv\r\n"},
+        {"TTL k", ":10\r\n"},
+        {"SET k v PX 1500", "+OK\r\n"},
+        {"SET k v EX 0", badExpire},
+        {"SET k v PX -5", badExpire},
+        {"SET k v EX abc", badExpire},
+        // Deadlines past the clock's range
+        {"SET k v EX 9223372036854775807", badExpire},
+        {"SET k v PX 9223372036854775807", badExpire},
+        {"SET k v EX 9300000000", badExpire},
+        {"SET k v PX 9300000000000", badExpire},
+        {"GET k", "$1\r\nv\r\n"},
+    };
+
+    int failures = 0;
+    for (auto &[request, expected] : cases)
+    {
+        string line = request + "\r\n";
+        ::send(fd, line.data(), line.size(), MSG_NOSIGNAL);
+        string reply;
+        char buf[256];
+        while (reply.size() < expected.size())
+        {
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                break;
+            reply.append(buf, n);
+        }
+        if (reply != expected)
+        {
+            cout << "FAIL " << request << ": got " << quoted(reply) << ", want " << quoted(expected) << endl;
+            failures++;
+        }
+    }
+    ::close(fd);
+    cout << cases.size() - failures << "/" << cases.size() << " checks passed" << endl;
+    // The reactor runs until the process exits
+    _Exit(failures ? 1 : 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && string(argv[1]) == "check")
+        return check();
+
+    uint16_t port = argc > 1 ? stoi(argv[1]) : 6379;
+    unsigned reactors = argc > 2 ? stoi(argv[2]) : max(thread::hardware_concurrency(), 1u);
+    size_t shards = argc > 3 ? stoul(argv[3]) : 64;
+    size_t maxBytes = argc > 4 ? stoull(argv[4]) : 0;
+
+    KeyValueStore<> store(shards, maxBytes);
+
+    vector<unique_ptr<Reactor>> loops;
+    for (unsigned i = 0; i < reactors; i++)
+        loops.push_back(make_unique<Reactor>(store, port));
+
+    cout << "listening on 127.0.0.1:" << port << " with " << reactors << " reactors" << endl;
+    for (auto &loop : loops)
+        loop->join();
+}
@@ -0,0 +1,188 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+enum CompressionType
+{
+    NO_COMPRESSION = 0,
+    LZ4_COMPRESSION = 1
+};
+
+// Compresses sealed record batches. decompress() is given the exact raw size
+// the batch recorded and throws on corrupt input.
+class Codec
+{
+public:
+    virtual CompressionType type() const = 0;
+    virtual void compress(string_view in, string &out) const = 0;
+    virtual void decompress(string_view in, size_t rawSize, string &out) const = 0;
+    virtual ~Codec() = default;
+};
+
+class NoCompression : public Codec
+{
+public:
+    CompressionType type() const override
+    {
+        return NO_COMPRESSION;
+    }
+
+    void compress(string_view in, string &out) const override
+    {
+        out.assign(in.data(), in.size());
+    }
+
+    void decompress(string_view in, size_t rawSize, string &out) const override
+    {
+        if (in.size() != rawSize)
+            throw runtime_error("corrupt batch");
+        out.assign(in.data(), in.size());
+    }
+};
+
+// Self-contained encoder/decoder for the LZ4 block format: sequences of
+// literals plus (offset, length) back-references into a 64 KiB window. A
+// greedy single-probe hash match, which suits short repetitive JSON well.
+class Lz4Codec : public Codec
+{
+private:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t LAST_LITERALS = 5;
+    static constexpr size_t MATCH_LIMIT = 12; // no match may start within this many bytes of the end
+    static constexpr int HASH_BITS = 12;
+
+    static uint32_t read32(const char *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    static void writeLength(string &out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            out.push_back(char(255));
+        out.push_back(char(length));
+    }
+
+    static void emit(string &out, const char *literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        size_t extraMatch = matchLength ? matchLength - MIN_MATCH : 0;
+        out.push_back(char((min<size_t>(literalLength, 15) << 4) | min<size_t>(extraMatch, 15)));
+        if (literalLength >= 15)
+            writeLength(out, literalLength - 15);
+        out.append(literals, literalLength);
+
+        if (!matchLength)
+            return;
+        out.push_back(char(offset & 0xff));
+        out.push_back(char(offset >> 8));
+        if (extraMatch >= 15)
+            writeLength(out, extraMatch - 15);
+    }
+
+public:
+    CompressionType type() const override
+    {
+        return LZ4_COMPRESSION;
+    }
+
+    void compress(string_view in, string &out) const override
+    {
+        out.clear();
+        out.reserve(in.size() + in.size() / 255 + 16);
+        const char *src = in.data();
+        size_t n = in.size(), anchor = 0;
+
+        if (n > MATCH_LIMIT)
+        {
+            vector<uint32_t> table(1 << HASH_BITS, UINT32_MAX);
+            for (size_t i = 0; i < n - MATCH_LIMIT;)
+            {
+                uint32_t sequence = read32(src + i);
+                uint32_t &slot = table[(sequence * 2654435761u) >> (32 - HASH_BITS)];
+                size_t ref = slot;
+                slot = i;
+
+                if (ref == UINT32_MAX || i - ref > 65535 || read32(src + ref) != sequence)
+                {
+                    i++;
+                    continue;
+                }
+
+                size_t length = MIN_MATCH;
+                while (i + length < n - LAST_LITERALS && src[ref + length] == src[i + length])
+                    length++;
+
+                emit(out, src + anchor, i - anchor, i - ref, length);
+                i += length;
+                anchor = i;
+            }
+        }
+        emit(out, src + anchor, n - anchor, 0, 0);
+    }
+
+    void decompress(string_view in, size_t rawSize, string &out) const override
+    {
+        out.resize(rawSize);
+        char *dst = out.data();
+        size_t p = 0, q = 0;
+
+        auto readLength = [&](size_t length)
+        {
+            if (length == 15)
+            {
+                unsigned char byte;
+                do
+                {
+                    if (p >= in.size())
+                        throw runtime_error("corrupt batch");
+                    byte = in[p++];
+                    length += byte;
+                } while (byte == 255);
+            }
+            return length;
+        };
+
+        while (p < in.size())
+        {
+            unsigned char token = in[p++];
+            size_t literalLength = readLength(token >> 4);
+            if (literalLength > in.size() - p || literalLength > rawSize - q)
+                throw runtime_error("corrupt batch");
+            memcpy(dst + q, in.data() + p, literalLength);
+            p += literalLength;
+            q += literalLength;
+
+            if (p == in.size())
+                break;
+            if (p + 2 > in.size())
+                throw runtime_error("corrupt batch");
+            size_t offset = (unsigned char)in[p] | ((unsigned char)in[p + 1] << 8);
+            p += 2;
+            size_t matchLength = readLength(token & 15) + MIN_MATCH;
+            if (!offset || offset > q || matchLength > rawSize - q)
+                throw runtime_error("corrupt batch");
+
+            // An overlapping match repeats bytes it is still writing
+            if (offset >= matchLength)
+                memcpy(dst + q, dst + q - offset, matchLength);
+            else
+                for (size_t k = 0; k < matchLength; k++)
+                    dst[q + k] = dst[q + k - offset];
+            q += matchLength;
+        }
+
+        if (q != rawSize)
+            throw runtime_error("corrupt batch");
+    }
+};
+
+static unique_ptr<Codec> makeCodec(CompressionType type)
+{
+    if (type == LZ4_COMPRESSION)
+        return make_unique<Lz4Codec>();
+    return make_unique<NoCompression>();
+}
@@ -0,0 +1,228 @@
+#include "bits/stdc++.h"
+#include "QueueTopic.cpp"
+
+using namespace std;
+
+#pragma once
+
+// Offsets in batch are within the lane; lane is 0 unless the topic has
+// priority lanes
+struct PartitionBatch
+{
+    size_t partition;
+    MessageBatch batch;
+    size_t lane = 0;
+};
+
+// How far a group trails one lane of a partition. lag counts messages past
+// the committed offset; owner is empty while the partition is unassigned.
+struct PartitionLag
+{
+    size_t partition;
+    size_t lane;
+    string owner;
+    size_t committed;
+    size_t position;
+    size_t endOffset;
+    size_t lag;
+};
+
+// Members of a group share one topic's partitions; each partition belongs to
+// exactly one member at a time. Any join, leave or session expiry reassigns
+// the partitions round-robin over the members and bumps the generation.
+// The group tracks two offsets per partition: a fetch position that poll()
+// advances, and the committed offset. A rebalance resets the position to the
+// committed offset, so the new owner gets uncommitted messages again.
+// A partition is read by one poll at a time, so concurrent polls never hand
+// out the same messages twice.
+//
+// On a topic with priority lanes both offsets are kept per lane, and a poll
+// drains a partition's lanes from the most urgent down, like
+// QueueTopic::readByPriority.
+class ConsumerGroup
+{
+private:
+    struct Member
+    {
+        vector<size_t> partitions;
+        TimePoint lastSeen;
+    };
+
+    string name;
+    shared_ptr<QueueTopic> topic;
+    size_t lanes;
+    chrono::milliseconds sessionTimeout;
+
+    mutex mtx;
+    map<string, Member> members;
+    vector<string> owners; // partition -> member id, empty if unassigned
+    // Lane l of partition p at p * lanes + l
+    vector<size_t> committed;
+    vector<size_t> positions;
+    vector<char> fetching; // partition -> a poll is reading it
+    uint64_t generation = 0;
+
+    void rebalance()
+    {
+        generation++;
+        positions = committed;
+        owners.assign(owners.size(), "");
+        for (auto &[id, member] : members)
+            member.partitions.clear();
+
+        if (members.empty())
+            return;
+
+        auto it = members.begin();
+        for (size_t p = 0; p < owners.size(); p++)
+        {
+            it->second.partitions.push_back(p);
+            owners[p] = it->first;
+            if (++it == members.end())
+                it = members.begin();
+        }
+    }
+
+public:
+    ConsumerGroup(string name, shared_ptr<QueueTopic> topic, chrono::milliseconds sessionTimeout)
+        : name(name), topic(std::move(topic)), lanes(this->topic->priorityLanes()), sessionTimeout(sessionTimeout),
+          owners(this->topic->partitionCount()), committed(this->topic->partitionCount() * lanes, 0),
+          positions(this->topic->partitionCount() * lanes, 0), fetching(this->topic->partitionCount(), 0) {}
+
+    const shared_ptr<QueueTopic> &subscribedTopic() const
+    {
+        return topic;
+    }
+
+    // Also serves as a heartbeat for an existing member; returns the generation
+    uint64_t join(const string &memberId)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto [it, inserted] = members.try_emplace(memberId);
+        it->second.lastSeen = chrono::steady_clock::now();
+        if (inserted)
+            rebalance();
+        return generation;
+    }
+
+    void leave(const string &memberId)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (members.erase(memberId))
+            rebalance();
+    }
+
+    vector<size_t> assignment(const string &memberId)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto it = members.find(memberId);
+        return it == members.end() ? vector<size_t>() : it->second.partitions;
+    }
+
+    // Up to batchSize messages from each assigned partition, in one entry per
+    // non-empty lane, most urgent first. The lock is not
+    // held while reading, so each partition is reserved first; a partition
+    // that another poll is still reading is skipped this time. Positions
+    // only advance if no rebalance happened meanwhile.
+    vector<PartitionBatch> poll(const string &memberId, int batchSize)
+    {
+        vector<size_t> fetches;
+        vector<size_t> offsets; // `lanes` per fetched partition
+        uint64_t fetchGeneration;
+        {
+            lock_guard<mutex> lock(mtx);
+            auto it = members.find(memberId);
+            if (it == members.end())
+                return {};
+            it->second.lastSeen = chrono::steady_clock::now();
+            fetchGeneration = generation;
+            for (size_t p : it->second.partitions)
+                if (!fetching[p])
+                {
+                    fetching[p] = 1;
+                    fetches.push_back(p);
+                    offsets.insert(offsets.end(), positions.begin() + p * lanes, positions.begin() + (p + 1) * lanes);
+                }
+        }
+
+        vector<PartitionBatch> result;
+        for (size_t i = 0; i < fetches.size(); i++)
+        {
+            int budget = batchSize;
+            for (size_t lane = lanes; lane-- > 0 && budget > 0;)
+            {
+                MessageBatch batch = topic->readLane(fetches[i], lane, offsets[i * lanes + lane], budget);
+                if (batch.empty())
+                    continue;
+                budget -= int(batch.size());
+                result.push_back({fetches[i], std::move(batch), lane});
+            }
+        }
+
+        lock_guard<mutex> lock(mtx);
+        for (size_t i = 0; i < fetches.size(); i++)
+        {
+            size_t p = fetches[i];
+            fetching[p] = 0;
+            if (generation == fetchGeneration)
+                copy(offsets.begin() + i * lanes, offsets.begin() + (i + 1) * lanes, positions.begin() + p * lanes);
+        }
+        return result;
+    }
+
+    // offset is the next message to consume. Rejected unless memberId owns the partition.
+    bool commit(const string &memberId, size_t partition, size_t offset, size_t lane = 0)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (partition >= owners.size() || lane >= lanes || owners[partition] != memberId)
+            return false;
+        committed[partition * lanes + lane] = offset;
+        return true;
+    }
+
+    size_t committedOffset(size_t partition, size_t lane = 0)
+    {
+        lock_guard<mutex> lock(mtx);
+        return partition < owners.size() && lane < lanes ? committed[partition * lanes + lane] : 0;
+    }
+
+    // One entry per partition and lane. End offsets are read after the
+    // group's lock is released, so a busy partition may show slightly more
+    // lag than it has.
+    vector<PartitionLag> lag()
+    {
+        vector<PartitionLag> result;
+        {
+            lock_guard<mutex> lock(mtx);
+            for (size_t p = 0; p < owners.size(); p++)
+                for (size_t lane = 0; lane < lanes; lane++)
+                    result.push_back({p, lane, owners[p], committed[p * lanes + lane], positions[p * lanes + lane], 0, 0});
+        }
+        for (auto &partition : result)
+        {
+            partition.endOffset = topic->endOffset(partition.partition, partition.lane);
+            partition.lag = partition.endOffset > partition.committed ? partition.endOffset - partition.committed : 0;
+        }
+        return result;
+    }
+
+    // Drops members that have neither polled nor joined within the session timeout
+    void expireMembers()
+    {
+        lock_guard<mutex> lock(mtx);
+        auto deadline = chrono::steady_clock::now() - sessionTimeout;
+        bool changed = false;
+        for (auto it = members.begin(); it != members.end();)
+        {
+            if (it->second.lastSeen < deadline)
+            {
+                it = members.erase(it);
+                changed = true;
+            }
+            else
+                it++;
+        }
+        if (changed)
+            rebalance();
+    }
+};
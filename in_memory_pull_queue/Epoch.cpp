@@ -0,0 +1,228 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+// Epoch-based reclamation. Readers pin the current epoch for the duration of
+// an EpochGuard; writers unlink an object and retire() it, and it is freed
+// once the global epoch has moved two steps past the retire epoch, by which
+// point no reader that could have seen it is still pinned. There is a single
+// process-wide domain so a thread needs only one record.
+class EpochDomain
+{
+private:
+    static constexpr uint64_t IDLE = numeric_limits<uint64_t>::max();
+    static constexpr size_t RECLAIM_THRESHOLD = 64;
+
+    struct Retired
+    {
+        void *ptr;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    // One per thread, recycled after the thread exits; never freed before the domain
+    struct alignas(64) Record
+    {
+        atomic<uint64_t> epoch{IDLE};
+        atomic<bool> inUse{false};
+        Record *next = nullptr;
+
+        // Owner thread only
+        int depth = 0;
+        vector<Retired> retired;
+    };
+
+    struct LocalHolder
+    {
+        EpochDomain *domain = nullptr;
+        Record *record = nullptr;
+
+        ~LocalHolder()
+        {
+            if (record)
+                domain->release(record);
+        }
+    };
+
+    atomic<uint64_t> globalEpoch{2};
+    atomic<Record *> records{nullptr};
+
+    // Retired objects left behind by exited threads or passed to retireShared()
+    mutex orphanMtx;
+    vector<Retired> orphans;
+
+    Record *acquire()
+    {
+        for (Record *r = records.load(); r; r = r->next)
+        {
+            bool expected = false;
+            if (!r->inUse.load() && r->inUse.compare_exchange_strong(expected, true))
+                return r;
+        }
+
+        Record *r = new Record();
+        r->inUse = true;
+        r->next = records.load();
+        while (!records.compare_exchange_weak(r->next, r))
+            ;
+        return r;
+    }
+
+    void release(Record *r)
+    {
+        {
+            lock_guard<mutex> lock(orphanMtx);
+            orphans.insert(orphans.end(), r->retired.begin(), r->retired.end());
+        }
+        r->retired.clear();
+        r->depth = 0;
+        r->epoch.store(IDLE);
+        r->inUse.store(false);
+    }
+
+    Record *local()
+    {
+        static thread_local LocalHolder holder;
+        if (!holder.record)
+        {
+            holder.domain = this;
+            holder.record = acquire();
+        }
+        return holder.record;
+    }
+
+    // The epoch can only move once every pinned reader has observed it
+    void tryAdvance()
+    {
+        uint64_t current = globalEpoch.load();
+        for (Record *r = records.load(); r; r = r->next)
+        {
+            uint64_t e = r->epoch.load();
+            if (e != IDLE && e != current)
+                return;
+        }
+        globalEpoch.compare_exchange_strong(current, current + 1);
+    }
+
+    void freeExpired(vector<Retired> &list)
+    {
+        tryAdvance();
+        uint64_t safe = globalEpoch.load();
+
+        auto it = partition(list.begin(), list.end(), [safe](const Retired &r)
+                            { return r.epoch + 2 > safe; });
+        for (auto freeIt = it; freeIt != list.end(); freeIt++)
+            freeIt->deleter(freeIt->ptr);
+        list.erase(it, list.end());
+    }
+
+    EpochDomain() = default;
+
+public:
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    ~EpochDomain()
+    {
+        Record *r = records.load();
+        while (r)
+        {
+            for (auto &item : r->retired)
+                item.deleter(item.ptr);
+            Record *next = r->next;
+            delete r;
+            r = next;
+        }
+        for (auto &item : orphans)
+            item.deleter(item.ptr);
+    }
+
+    static EpochDomain &global()
+    {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void enter()
+    {
+        Record *r = local();
+        if (r->depth++ == 0)
+            r->epoch.store(globalEpoch.load()); // seq_cst: published before any read that follows
+    }
+
+    void exit()
+    {
+        Record *r = local();
+        if (--r->depth == 0)
+            r->epoch.store(IDLE, memory_order_release);
+    }
+
+    // ptr must already be unreachable for new readers
+    void retire(void *ptr, void (*deleter)(void *))
+    {
+        Record *r = local();
+        r->retired.push_back({ptr, deleter, globalEpoch.load()});
+        if (r->retired.size() >= RECLAIM_THRESHOLD)
+            freeExpired(r->retired);
+    }
+
+    template <typename T>
+    void retire(T *ptr)
+    {
+        retire(ptr, [](void *p)
+               { delete static_cast<T *>(p); });
+    }
+
+    // For objects retired on whichever thread happens to unlink them but
+    // reclaimed elsewhere: they go on the shared list collect() drains,
+    // rather than sitting on a thread list that may not grow again
+    void retireShared(void *ptr, void (*deleter)(void *))
+    {
+        lock_guard<mutex> lock(orphanMtx);
+        orphans.push_back({ptr, deleter, globalEpoch.load()});
+    }
+
+    // Frees whatever is reclaimable from this thread, from exited threads
+    // and from retireShared(). True if the shared list is now empty.
+    bool collect()
+    {
+        freeExpired(local()->retired);
+
+        lock_guard<mutex> lock(orphanMtx);
+        freeExpired(orphans);
+        return orphans.empty();
+    }
+};
+
+// Pins the current epoch on this thread; must be released on the same thread
+class EpochGuard
+{
+private:
+    EpochDomain *domain;
+
+public:
+    EpochGuard() : domain(&EpochDomain::global())
+    {
+        domain->enter();
+    }
+
+    // Holds nothing; lets owners of a guard be default-constructible
+    explicit EpochGuard(nullptr_t) : domain(nullptr) {}
+
+    EpochGuard(EpochGuard &&other) noexcept : domain(other.domain)
+    {
+        other.domain = nullptr;
+    }
+
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard &operator=(const EpochGuard &) = delete;
+    EpochGuard &operator=(EpochGuard &&) = delete;
+
+    ~EpochGuard()
+    {
+        if (domain)
+            domain->exit();
+    }
+};
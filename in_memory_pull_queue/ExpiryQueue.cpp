@@ -0,0 +1,79 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+// Min-heap of (deadline, item) for a single timer thread. Scheduling an
+// earlier deadline than the current head wakes the thread; nothing else does.
+template <typename T>
+class ExpiryQueue
+{
+private:
+    struct Entry
+    {
+        chrono::steady_clock::time_point deadline;
+        T item;
+
+        bool operator>(const Entry &other) const
+        {
+            return deadline > other.deadline;
+        }
+    };
+
+    priority_queue<Entry, vector<Entry>, greater<Entry>> heap;
+    mutex mtx;
+    condition_variable cv;
+    bool stopped = false;
+
+public:
+    void schedule(T item, chrono::steady_clock::time_point deadline)
+    {
+        bool earliest;
+        {
+            lock_guard<mutex> lock(mtx);
+            earliest = heap.empty() || deadline < heap.top().deadline;
+            heap.push({deadline, std::move(item)});
+        }
+        if (earliest)
+            cv.notify_one();
+    }
+
+    // Waits for the earliest due item. Returns false once `until` passes
+    // with nothing due, or after stop().
+    bool next(T &item, chrono::steady_clock::time_point until)
+    {
+        unique_lock<mutex> lock(mtx);
+        while (!stopped)
+        {
+            auto now = chrono::steady_clock::now();
+            if (!heap.empty() && heap.top().deadline <= now)
+            {
+                item = std::move(const_cast<Entry &>(heap.top()).item);
+                heap.pop();
+                return true;
+            }
+            if (now >= until)
+                return false;
+            // A copy: the heap may reallocate while we wait
+            chrono::steady_clock::time_point wakeAt = heap.empty() ? until : min(until, heap.top().deadline);
+            cv.wait_until(lock, wakeAt);
+        }
+        return false;
+    }
+
+    void stop()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopped = true;
+        }
+        cv.notify_all();
+    }
+
+    size_t size()
+    {
+        lock_guard<mutex> lock(mtx);
+        return heap.size();
+    }
+};
@@ -0,0 +1,92 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+using TimePoint = chrono::steady_clock::time_point;
+
+// Stored timestamps are wall-clock unix milliseconds; deadlines are steady
+static int64_t unixNowMs()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static TimePoint steadyFromUnixMs(int64_t unixMs)
+{
+    return chrono::steady_clock::now() + chrono::milliseconds(max<int64_t>(unixMs - unixNowMs(), 0));
+}
+
+struct Message
+{
+    string content;
+};
+
+struct MessageView
+{
+    size_t offset;
+    string_view content;
+};
+
+// Messages read without copying. The views stay valid for as long as the
+// batch holds its pins on the storage behind them, even if that storage is
+// trimmed in the meantime.
+class MessageBatch
+{
+private:
+    vector<MessageView> messages;
+    vector<shared_ptr<const void>> pins;
+
+public:
+    void reserve(size_t n)
+    {
+        messages.reserve(n);
+    }
+
+    void add(size_t offset, string_view content)
+    {
+        messages.push_back({offset, content});
+    }
+
+    void pin(shared_ptr<const void> owner)
+    {
+        pins.push_back(std::move(owner));
+    }
+
+    // Appends other's views after this batch's own
+    void merge(MessageBatch other)
+    {
+        if (messages.empty())
+        {
+            *this = std::move(other);
+            return;
+        }
+        messages.insert(messages.end(), other.messages.begin(), other.messages.end());
+        pins.insert(pins.end(), make_move_iterator(other.pins.begin()), make_move_iterator(other.pins.end()));
+    }
+
+    size_t size() const
+    {
+        return messages.size();
+    }
+
+    bool empty() const
+    {
+        return messages.empty();
+    }
+
+    const MessageView &operator[](size_t i) const
+    {
+        return messages[i];
+    }
+
+    vector<MessageView>::const_iterator begin() const
+    {
+        return messages.begin();
+    }
+
+    vector<MessageView>::const_iterator end() const
+    {
+        return messages.end();
+    }
+};
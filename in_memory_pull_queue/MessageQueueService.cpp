@@ -0,0 +1,430 @@
+#include "bits/stdc++.h"
+#include "ConsumerGroup.cpp"
+#include "ExpiryQueue.cpp"
+#include "TopicRegistry.cpp"
+
+using namespace std;
+
+#pragma once
+
+class MessageQueueService
+{
+private:
+    TopicRegistry topics;
+
+    // Guards groupMap only; topic lookups never lock
+    unordered_map<string, shared_ptr<ConsumerGroup>> groupMap;
+    shared_timed_mutex sharedMtx;
+
+    chrono::milliseconds ttl;
+    TopicOptions options;
+
+    thread cleanupThread;
+    atomic<bool> stop{false};
+
+    enum TimerKind
+    {
+        CLEANUP = 0,       // the topic's single cleanup entry
+        PENDING_BATCH = 1, // deadline of one of its queued async batches
+        DELIVERY = 2       // when its next delayed message is due
+    };
+
+    struct Timer
+    {
+        shared_ptr<QueueTopic> topic;
+        TimerKind kind = CLEANUP;
+        TimePoint deadline{};
+    };
+
+    // Topics whose oldest message expires next; only those are cleaned
+    ExpiryQueue<Timer> expiries;
+
+    // Adds the topic to the expiry queue unless it is already there. The
+    // deadline is never later than a message pushed just now would need.
+    void scheduleExpiry(const shared_ptr<QueueTopic> &topic)
+    {
+        if (topic->claimExpiry())
+            expiries.schedule({topic, CLEANUP}, min(topic->nextExpiry(), chrono::steady_clock::now() + ttl));
+    }
+
+    // Runs f on the named topic, if any, without copying its handle
+    template <typename F>
+    void withTopic(const string &topicName, F f)
+    {
+        EpochGuard guard;
+        if (const TopicHandle *topic = topics.find(topicName))
+            f(*topic);
+    }
+
+    // Like withTopic(), but a push that may block on the quota copies the
+    // handle first, as a blocking read does
+    template <typename F>
+    PushResult pushTo(const string &topicName, F f)
+    {
+        if (options.overflow == BLOCK && (options.quotaBytes || options.quotaMessages))
+        {
+            TopicHandle topic = topics.get(topicName);
+            return topic ? f(topic) : REJECTED;
+        }
+
+        PushResult result = REJECTED;
+        withTopic(topicName, [&](const TopicHandle &topic)
+                  { result = f(topic); });
+        return result;
+    }
+
+    void scheduleDelivery(const shared_ptr<QueueTopic> &topic, TimePoint deadline)
+    {
+        if (deadline != TimePoint::max())
+            expiries.schedule({topic, DELIVERY, deadline}, deadline);
+    }
+
+    // Delivered messages need cleaning up a TTL later
+    void deliver(const shared_ptr<QueueTopic> &topic, TimePoint timer)
+    {
+        scheduleDelivery(topic, topic->deliverDue(timer));
+        scheduleExpiry(topic);
+    }
+
+    void expire(const shared_ptr<QueueTopic> &topic)
+    {
+        topic->cleanup();
+
+        // A push after the release schedules the topic itself
+        topic->releaseExpiry();
+        if (topic->nextExpiry() != TimePoint::max())
+            scheduleExpiry(topic);
+    }
+
+public:
+    MessageQueueService(chrono::milliseconds ttl, TopicOptions options = {}) : ttl(ttl), options(std::move(options))
+    {
+        cleanupThread = thread([this]()
+                               {
+            auto nextGroupSweep = chrono::steady_clock::now() + chrono::seconds(3);
+            Timer timer;
+
+            while(!stop){
+                if(expiries.next(timer, nextGroupSweep)){
+                    if(timer.kind == PENDING_BATCH)
+                        timer.topic->expirePending();
+                    else if(timer.kind == DELIVERY)
+                        deliver(timer.topic, timer.deadline);
+                    else
+                        expire(timer.topic);
+                    timer.topic.reset();
+                    continue;
+                }
+
+                if(stop)
+                    break;
+
+                nextGroupSweep = chrono::steady_clock::now() + chrono::seconds(3);
+                shared_lock<shared_timed_mutex> lock(sharedMtx);
+                for(auto &it: groupMap) it.second->expireMembers();
+            } });
+    }
+
+    ~MessageQueueService()
+    {
+        stop = true;
+        topics.forEach([](const TopicHandle &topic)
+                       { topic->close(); });
+
+        expiries.stop();
+
+        if (cleanupThread.joinable())
+            cleanupThread.join();
+    }
+
+    // A topic's partition count is fixed when it is created. Returns the
+    // topic's handle, whether or not this call created it.
+    TopicHandle createTopic(string name, size_t partitions = 1)
+    {
+        if (stop)
+            return nullptr;
+
+        auto [topic, created] = topics.add(name, [&]()
+                                           { return make_shared<QueueTopic>(name, ttl, options, partitions); });
+
+        // A log recovered from disk may already hold messages
+        if (created && topic->nextExpiry() != TimePoint::max())
+            scheduleExpiry(topic);
+        return topic;
+    }
+
+    // Null if the topic does not exist
+    TopicHandle topic(string name)
+    {
+        return topics.get(name);
+    }
+
+    // REJECTED or TIMED_OUT when the topic's quota holds the message back;
+    // see OverflowPolicy
+    PushResult push(const TopicHandle &topic, Message msg)
+    {
+        if (stop)
+            return REJECTED;
+
+        PushResult result = topic->push(std::move(msg));
+        if (result == ACCEPTED)
+            scheduleExpiry(topic);
+        return result;
+    }
+
+    // Messages with the same key go to the same partition, in push order
+    PushResult push(const TopicHandle &topic, string_view key, Message msg)
+    {
+        if (stop)
+            return REJECTED;
+
+        PushResult result = topic->push(key, std::move(msg));
+        if (result == ACCEPTED)
+            scheduleExpiry(topic);
+        return result;
+    }
+
+    // Into a priority lane and/or delayed until options.deliverAt. A delayed
+    // message gets its offset when it is delivered.
+    PushResult push(const TopicHandle &topic, Message msg, const PushOptions &options)
+    {
+        if (stop)
+            return REJECTED;
+
+        PushResult result = topic->pushTo(topic->roundRobin(), std::move(msg), options);
+        if (result != ACCEPTED)
+            return result;
+        if (options.deliverAt != TimePoint())
+            scheduleDelivery(topic, topic->claimDelayTimer());
+        scheduleExpiry(topic);
+        return result;
+    }
+
+    PushResult push(const TopicHandle &topic, string_view key, Message msg, const PushOptions &options)
+    {
+        if (stop)
+            return REJECTED;
+
+        PushResult result = topic->pushTo(topic->partitionFor(key), std::move(msg), options);
+        if (result != ACCEPTED)
+            return result;
+        if (options.deliverAt != TimePoint())
+            scheduleDelivery(topic, topic->claimDelayTimer());
+        scheduleExpiry(topic);
+        return result;
+    }
+
+    // Producer-side batching: one lock and, for BATCHED topics, one sealed batch
+    PushResult pushBatch(const TopicHandle &topic, vector<Message> msgs)
+    {
+        if (stop)
+            return REJECTED;
+
+        PushResult result = topic->pushBatch(std::move(msgs));
+        if (result == ACCEPTED)
+            scheduleExpiry(topic);
+        return result;
+    }
+
+    // Like pushBatch(), but a producer over a BLOCK quota gets a future
+    // instead of waiting. Batches queued this way keep their order.
+    future<PushResult> pushBatchAsync(const TopicHandle &topic, vector<Message> msgs)
+    {
+        if (stop)
+        {
+            promise<PushResult> rejected;
+            rejected.set_value(REJECTED);
+            return rejected.get_future();
+        }
+
+        TimePoint deadline;
+        future<PushResult> result = topic->pushBatchAsync(std::move(msgs), deadline);
+        if (deadline != TimePoint::max())
+            expiries.schedule({topic, PENDING_BATCH}, deadline);
+        // Cleaned up at the latest a TTL after the batch gets in
+        scheduleExpiry(topic);
+        return result;
+    }
+
+    PushResult push(string topicName, Message msg)
+    {
+        return pushTo(topicName, [&](const TopicHandle &topic)
+                      { return push(topic, std::move(msg)); });
+    }
+
+    PushResult push(string topicName, string_view key, Message msg)
+    {
+        return pushTo(topicName, [&](const TopicHandle &topic)
+                      { return push(topic, key, std::move(msg)); });
+    }
+
+    PushResult push(string topicName, Message msg, const PushOptions &options)
+    {
+        return pushTo(topicName, [&](const TopicHandle &topic)
+                      { return push(topic, std::move(msg), options); });
+    }
+
+    PushResult push(string topicName, string_view key, Message msg, const PushOptions &options)
+    {
+        return pushTo(topicName, [&](const TopicHandle &topic)
+                      { return push(topic, key, std::move(msg), options); });
+    }
+
+    PushResult pushBatch(string topicName, vector<Message> msgs)
+    {
+        return pushTo(topicName, [&](const TopicHandle &topic)
+                      { return pushBatch(topic, std::move(msgs)); });
+    }
+
+    vector<Message> read(string topicName, size_t &offset, int batchSize)
+    {
+        vector<Message> msgs;
+        withTopic(topicName, [&](const TopicHandle &topic)
+                  {
+            if (!stop)
+                msgs = topic->get(offset, batchSize); });
+        return msgs;
+    }
+
+    // Like read(), but the messages are views into the topic's storage
+    MessageBatch readBatch(const TopicHandle &topic, size_t partition, size_t &offset, int batchSize)
+    {
+        if (stop)
+            return {};
+
+        return topic->read(partition, offset, batchSize);
+    }
+
+    MessageBatch readBatch(string topicName, size_t partition, size_t &offset, int batchSize)
+    {
+        MessageBatch batch;
+        withTopic(topicName, [&](const TopicHandle &topic)
+                  { batch = readBatch(topic, partition, offset, batchSize); });
+        return batch;
+    }
+
+    MessageBatch readBatch(string topicName, size_t &offset, int batchSize)
+    {
+        return readBatch(topicName, 0, offset, batchSize);
+    }
+
+    // Long poll; see ReadOptions
+    MessageBatch readBatch(const TopicHandle &topic, size_t partition, size_t &offset, const ReadOptions &options)
+    {
+        if (stop)
+            return {};
+
+        return topic->read(partition, offset, options);
+    }
+
+    // Resolves the name first: waiting inside an epoch guard would hold up reclamation
+    MessageBatch readBatch(string topicName, size_t partition, size_t &offset, const ReadOptions &options)
+    {
+        TopicHandle topic = topics.get(topicName);
+        return topic ? readBatch(topic, partition, offset, options) : MessageBatch();
+    }
+
+    // Most urgent lane first; see QueueTopic::readByPriority
+    MessageBatch readByPriority(const TopicHandle &topic, size_t partition, vector<size_t> &laneOffsets, int batchSize)
+    {
+        if (stop)
+            return {};
+
+        return topic->readByPriority(partition, laneOffsets, batchSize);
+    }
+
+    MessageBatch readByPriority(const TopicHandle &topic, size_t partition, vector<size_t> &laneOffsets,
+                                const ReadOptions &options)
+    {
+        if (stop)
+            return {};
+
+        return topic->readByPriority(partition, laneOffsets, options);
+    }
+
+    vector<Message> read(string topicName, size_t &offset, const ReadOptions &options)
+    {
+        vector<Message> msgs;
+        for (auto &view : readBatch(topicName, 0, offset, options))
+            msgs.push_back({string(view.content)});
+        return msgs;
+    }
+
+    // Joins (or heartbeats) memberId in a group consuming topicName, creating
+    // the group on first use. Returns the group generation, or 0 if the topic
+    // does not exist or the group already consumes a different topic.
+    uint64_t joinGroup(string groupName, string topicName, string memberId,
+                       chrono::milliseconds sessionTimeout = chrono::seconds(10))
+    {
+        TopicHandle topic = topics.get(topicName);
+        if (!topic)
+            return 0;
+
+        shared_ptr<ConsumerGroup> group;
+        {
+            lock_guard<shared_timed_mutex> lock(sharedMtx);
+
+            if (stop)
+                return 0;
+
+            auto it = groupMap.find(groupName);
+            if (it == groupMap.end())
+                it = groupMap.insert({groupName, make_shared<ConsumerGroup>(groupName, topic, sessionTimeout)}).first;
+            if (it->second->subscribedTopic() != topic)
+                return 0;
+            group = it->second;
+        }
+        return group->join(memberId);
+    }
+
+    void leaveGroup(string groupName, string memberId)
+    {
+        if (auto group = findGroup(groupName))
+            group->leave(memberId);
+    }
+
+    vector<size_t> assignment(string groupName, string memberId)
+    {
+        auto group = findGroup(groupName);
+        return group ? group->assignment(memberId) : vector<size_t>();
+    }
+
+    // Reads on from the group's position in each partition assigned to memberId
+    vector<PartitionBatch> pollGroup(string groupName, string memberId, int batchSize)
+    {
+        auto group = findGroup(groupName);
+        return group ? group->poll(memberId, batchSize) : vector<PartitionBatch>();
+    }
+
+    // lane is PartitionBatch::lane of the batch being committed
+    bool commitOffset(string groupName, string memberId, size_t partition, size_t offset, size_t lane = 0)
+    {
+        auto group = findGroup(groupName);
+        return group && group->commit(memberId, partition, offset, lane);
+    }
+
+    size_t committedOffset(string groupName, size_t partition, size_t lane = 0)
+    {
+        auto group = findGroup(groupName);
+        return group ? group->committedOffset(partition, lane) : 0;
+    }
+
+    // Per-partition (and per-lane) lag of a group behind the topic's end
+    vector<PartitionLag> consumerLag(string groupName)
+    {
+        auto group = findGroup(groupName);
+        return group ? group->lag() : vector<PartitionLag>();
+    }
+
+private:
+    shared_ptr<ConsumerGroup> findGroup(const string &groupName)
+    {
+        shared_lock<shared_timed_mutex> lock(sharedMtx);
+
+        if (stop)
+            return nullptr;
+
+        auto it = groupMap.find(groupName);
+        return it == groupMap.end() ? nullptr : it->second;
+    }
+};
@@ -0,0 +1,101 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+// Consumers blocked until a partition reaches some end offset. Each waiter
+// has its own condition variable and is woken only once its target offset
+// is written, so a push wakes nobody else. With no waiters, notify() costs a
+// single atomic load.
+class OffsetWaiters
+{
+private:
+    struct Waiter
+    {
+        condition_variable cv;
+        bool ready = false;
+    };
+
+    mutex mtx;
+    multimap<size_t, Waiter *> waiters;
+    atomic<size_t> lowestTarget{numeric_limits<size_t>::max()};
+    bool closed = false;
+
+    void updateLowest()
+    {
+        lowestTarget.store(waiters.empty() ? numeric_limits<size_t>::max() : waiters.begin()->first);
+    }
+
+    void wakeUpTo(size_t end)
+    {
+        auto last = waiters.upper_bound(end);
+        for (auto it = waiters.begin(); it != last; it++)
+        {
+            it->second->ready = true;
+            it->second->cv.notify_one();
+        }
+        waiters.erase(waiters.begin(), last);
+        updateLowest();
+    }
+
+public:
+    // Call after appending; endOffset is only evaluated if someone is waiting
+    template <typename EndOffset>
+    void notify(EndOffset endOffset)
+    {
+        // Pairs with the fence in wait(): either we see its target or it sees our append
+        atomic_thread_fence(memory_order_seq_cst);
+        if (lowestTarget.load(memory_order_relaxed) == numeric_limits<size_t>::max())
+            return;
+
+        size_t end = endOffset();
+        lock_guard<mutex> lock(mtx);
+        if (end >= lowestTarget.load(memory_order_relaxed))
+            wakeUpTo(end);
+    }
+
+    // Blocks until endOffset() >= target, the deadline passes or close() is
+    // called. Returns whether the target was reached.
+    template <typename EndOffset>
+    bool wait(size_t target, chrono::steady_clock::time_point deadline, EndOffset endOffset)
+    {
+        if (endOffset() >= target)
+            return true;
+
+        Waiter self;
+        unique_lock<mutex> lock(mtx);
+        if (closed)
+            return false;
+
+        auto it = waiters.emplace(target, &self);
+        if (target < lowestTarget.load(memory_order_relaxed))
+            lowestTarget.store(target);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        // An append that raced with registering will not have seen us
+        if (endOffset() >= target)
+        {
+            waiters.erase(it);
+            updateLowest();
+            return true;
+        }
+
+        self.cv.wait_until(lock, deadline, [&]()
+                           { return self.ready; });
+        if (!self.ready)
+        {
+            waiters.erase(it);
+            updateLowest();
+        }
+        return self.ready && !closed;
+    }
+
+    // Wakes every waiter and refuses new ones, e.g. on shutdown
+    void close()
+    {
+        lock_guard<mutex> lock(mtx);
+        closed = true;
+        wakeUpTo(numeric_limits<size_t>::max());
+    }
+};
@@ -0,0 +1,654 @@
+#include "bits/stdc++.h"
+#include "OffsetWaiters.cpp"
+#include "RecordBatch.cpp"
+#include "RingStorage.cpp"
+#include "SegmentedLog.cpp"
+
+using namespace std;
+
+#pragma once
+
+// What a push does while the topic is over its quota
+enum OverflowPolicy
+{
+    BLOCK = 0,      // wait up to blockTimeout for TTL or retention to free space
+    REJECT = 1,     // fail right away
+    DROP_OLDEST = 2 // drop from the front of the fullest partitions
+};
+
+enum PushResult
+{
+    ACCEPTED = 0,
+    REJECTED = 1, // over quota under REJECT, larger than the quota, or the topic closed
+    TIMED_OUT = 2
+};
+
+struct TopicOptions
+{
+    StorageType storage = MEMORY;
+
+    // SEGMENTED_LOG only: partition p of a topic lives in dir/<topic name>-<p>
+    string dir = "queue-data";
+    size_t segmentBytes = 64 << 20;
+
+    // RING only: messages retained before the oldest are overwritten
+    size_t ringCapacity = 1 << 20;
+
+    // BATCHED only: appends are sealed into a compressed batch at either limit
+    CompressionType compression = LZ4_COMPRESSION;
+    size_t batchMessages = 256;
+    size_t batchBytes = 64 << 10;
+
+    // Per partition, on top of the TTL; 0 means unlimited
+    size_t retentionBytes = 0;
+    size_t retentionMessages = 0;
+
+    // Whole topic, across partitions, as the storage counts bytes; 0 means
+    // unlimited. Checked before appending, so concurrent producers can
+    // overshoot it by what they have in flight.
+    size_t quotaBytes = 0;
+    size_t quotaMessages = 0;
+    OverflowPolicy overflow = BLOCK;
+    chrono::milliseconds blockTimeout{1000};
+
+    // Lane 0 is the ordinary log; lanes 1.. are for more urgent messages and
+    // are only seen by priority reads and consumer groups
+    size_t priorityLanes = 1;
+};
+
+// Per message; see QueueTopic::push
+struct PushOptions
+{
+    size_t priority = 0;  // lane, capped at the topic's last one
+    // Not readable before this; the default means now. Delivery needs the
+    // timer MessageQueueService runs, so a topic pushed to directly rejects
+    // a future deliverAt.
+    TimePoint deliverAt{};
+};
+
+// Blocking read: wait up to timeout for the first message, then up to maxWait
+// longer for minBatch of them, and return at most maxBatch
+struct ReadOptions
+{
+    int maxBatch = 100;
+    int minBatch = 1;
+    chrono::milliseconds timeout{0};
+    chrono::milliseconds maxWait{0};
+};
+
+// A topic is a fixed set of independent partitions, each with its own
+// storage and offsets. Keyed messages always land in the same partition;
+// unkeyed ones are spread round-robin.
+//
+// Each partition can also have priority lanes: more storages with offsets of
+// their own, which ordinary reads never see. A delayed message waits in a
+// heap and is appended to its lane once due, so it gets its offset then and
+// offsets stay dense and in delivery order. The service owns the timer that
+// delivers them, so only it may push delayed messages.
+class QueueTopic
+{
+    friend class MessageQueueService;
+
+private:
+    string name;
+    vector<unique_ptr<TopicStorage>> partitions;
+    unique_ptr<OffsetWaiters[]> waiters;
+    atomic<size_t> nextPartition{0};
+
+    // Lane l >= 1 of partition p is lanes[(l - 1) * partitions.size() + p].
+    // laneWaiters wait on the sum of a partition's lane end offsets.
+    size_t laneCount;
+    vector<unique_ptr<TopicStorage>> lanes;
+    unique_ptr<OffsetWaiters[]> laneWaiters;
+
+    struct Delayed
+    {
+        TimePoint deliverAt;
+        uint64_t seq; // keeps equal deadlines in push order
+        size_t partition;
+        size_t lane;
+        Message msg;
+
+        bool operator>(const Delayed &other) const
+        {
+            return tie(deliverAt, seq) > tie(other.deliverAt, other.seq);
+        }
+    };
+
+    // delayTimer is the deadline of the service timer that will deliver the
+    // heap's head; delayTimerUnclaimed is set when no such timer exists yet
+    mutex delayMtx;
+    priority_queue<Delayed, vector<Delayed>, greater<Delayed>> delayed;
+    uint64_t delayedSeq = 0;
+    TimePoint delayTimer = TimePoint::max();
+    bool delayTimerUnclaimed = false;
+    atomic<size_t> delayedMessages{0}, delayedBytes{0};
+
+    // Set while the topic has an entry in the service's expiry queue
+    atomic<bool> expiryScheduled{false};
+
+    struct PendingBatch
+    {
+        vector<Message> msgs;
+        size_t bytes;
+        TimePoint deadline;
+        promise<PushResult> done;
+    };
+
+    size_t quotaBytes, quotaMessages;
+    OverflowPolicy overflow;
+    chrono::milliseconds blockTimeout;
+    bool trimsOnAppend; // retention can free space during a push
+
+    // Producers blocked on the quota. Async batches queue in `pending` and
+    // are appended in order as space frees up.
+    mutex spaceMtx;
+    condition_variable spaceCv;
+    deque<PendingBatch> pending;
+    atomic<size_t> waiting{0}; // blocked pushes plus pending batches
+    bool closed = false;
+
+    static size_t payloadBytes(const vector<Message> &msgs)
+    {
+        size_t bytes = 0;
+        for (auto &msg : msgs)
+            bytes += msg.content.size();
+        return bytes;
+    }
+
+    bool limited() const
+    {
+        return quotaBytes || quotaMessages;
+    }
+
+    bool neverFits(size_t messages, size_t bytes) const
+    {
+        return (quotaMessages && messages > quotaMessages) || (quotaBytes && bytes > quotaBytes);
+    }
+
+    bool fits(size_t messages, size_t bytes)
+    {
+        StorageUsage used = usage();
+        return (!quotaMessages || used.messages + messages <= quotaMessages) &&
+               (!quotaBytes || used.bytes + bytes <= quotaBytes);
+    }
+
+    // Drops from the fullest partition until the push fits, or until that
+    // partition has nothing left it can drop
+    void makeRoom(size_t messages, size_t bytes)
+    {
+        while (!fits(messages, bytes))
+        {
+            StorageUsage used = usage();
+            used.messages += messages;
+            used.bytes += bytes;
+            size_t excessMessages = quotaMessages && used.messages > quotaMessages ? used.messages - quotaMessages : 0;
+            size_t excessBytes = quotaBytes && used.bytes > quotaBytes ? used.bytes - quotaBytes : 0;
+
+            TopicStorage *fullest = nullptr;
+            StorageUsage most;
+            forEachStorage([&](TopicStorage &storage)
+                           {
+                StorageUsage u = storage.usage();
+                if (!fullest || (excessMessages ? u.messages > most.messages : u.bytes > most.bytes))
+                {
+                    fullest = &storage;
+                    most = u;
+                } });
+            fullest->dropFront(excessMessages, excessBytes);
+
+            StorageUsage after = fullest->usage();
+            if (after.messages == most.messages && after.bytes == most.bytes)
+                break;
+        }
+    }
+
+    // Whether a push of this size may go ahead, waiting for space under BLOCK
+    PushResult admit(size_t messages, size_t bytes)
+    {
+        if (!limited())
+            return ACCEPTED;
+        if (neverFits(messages, bytes))
+            return REJECTED;
+        if (waiting.load(memory_order_relaxed) == 0 && fits(messages, bytes))
+            return ACCEPTED;
+
+        if (overflow == REJECT)
+            return REJECTED;
+        if (overflow == DROP_OLDEST)
+        {
+            makeRoom(messages, bytes);
+            return ACCEPTED;
+        }
+
+        unique_lock<mutex> lock(spaceMtx);
+        waiting.fetch_add(1);
+        // Pairs with the fence in spaceFreed()
+        atomic_thread_fence(memory_order_seq_cst);
+        bool admitted = spaceCv.wait_for(lock, blockTimeout, [&]()
+                                         { return closed || (pending.empty() && fits(messages, bytes)); });
+        waiting.fetch_sub(1);
+        return closed ? REJECTED : admitted ? ACCEPTED : TIMED_OUT;
+    }
+
+    template <typename F>
+    void forEachStorage(F f)
+    {
+        for (auto &storage : partitions)
+            f(*storage);
+        for (auto &storage : lanes)
+            f(*storage);
+    }
+
+    TopicStorage &storageOf(size_t partition, size_t lane)
+    {
+        return lane == 0 ? *partitions[partition] : *lanes[(lane - 1) * partitions.size() + partition];
+    }
+
+    size_t laneEndSum(size_t partition)
+    {
+        size_t sum = 0;
+        for (size_t lane = 0; lane < laneCount; lane++)
+            sum += storageOf(partition, lane).endOffset();
+        return sum;
+    }
+
+    void notifyAppended(size_t partition, size_t lane)
+    {
+        if (lane == 0)
+            waiters[partition].notify([&]()
+                                      { return partitions[partition]->endOffset(); });
+        if (laneCount > 1)
+            laneWaiters[partition].notify([&]()
+                                          { return laneEndSum(partition); });
+    }
+
+    void append(size_t partition, size_t lane, Message msg)
+    {
+        storageOf(partition, lane).append(std::move(msg));
+        notifyAppended(partition, lane);
+    }
+
+    void appendBatch(vector<Message> msgs)
+    {
+        size_t partition = roundRobin();
+        partitions[partition]->appendBatch(std::move(msgs));
+        notifyAppended(partition, 0);
+    }
+
+    // spaceMtx held. Appends queued batches that fit now and fails those past
+    // their deadline; stops at the first that has to keep waiting.
+    void drainPending()
+    {
+        auto now = chrono::steady_clock::now();
+        bool drained = false;
+        while (!pending.empty())
+        {
+            PendingBatch &front = pending.front();
+            if (!closed && fits(front.msgs.size(), front.bytes))
+            {
+                appendBatch(std::move(front.msgs));
+                front.done.set_value(ACCEPTED);
+            }
+            else if (closed || front.deadline <= now)
+                front.done.set_value(closed ? REJECTED : TIMED_OUT);
+            else
+                break;
+            pending.pop_front();
+            waiting.fetch_sub(1);
+            drained = true;
+        }
+
+        // Blocked pushes wait for the queue to empty
+        if (drained && pending.empty())
+            spaceCv.notify_all();
+    }
+
+    // Call after anything that may have shrunk the topic. Costs a fence and
+    // an atomic load when no producer is waiting.
+    void spaceFreed()
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (waiting.load(memory_order_relaxed) == 0)
+            return;
+
+        lock_guard<mutex> lock(spaceMtx);
+        drainPending();
+        spaceCv.notify_all();
+    }
+
+    // The deadline of a delivery timer the caller must now schedule, or
+    // TimePoint::max() if one is already scheduled early enough
+    TimePoint claimDelayTimer()
+    {
+        lock_guard<mutex> lock(delayMtx);
+        if (!delayTimerUnclaimed)
+            return TimePoint::max();
+        delayTimerUnclaimed = false;
+        return delayTimer;
+    }
+
+    // Run by the timer scheduled for `timer`. Appends every due message and
+    // returns the deadline to schedule next, or TimePoint::max(). A timer
+    // superseded by an earlier one does nothing.
+    TimePoint deliverDue(TimePoint timer)
+    {
+        TimePoint next;
+        bool appended = false;
+        {
+            lock_guard<mutex> lock(delayMtx);
+            if (timer != delayTimer)
+                return TimePoint::max();
+
+            auto now = chrono::steady_clock::now();
+            while (!delayed.empty() && delayed.top().deliverAt <= now)
+            {
+                Delayed &due = const_cast<Delayed &>(delayed.top());
+                delayedMessages.fetch_sub(1, memory_order_relaxed);
+                delayedBytes.fetch_sub(due.msg.content.size(), memory_order_relaxed);
+                append(due.partition, due.lane, std::move(due.msg));
+                delayed.pop();
+                appended = true;
+            }
+
+            next = delayTimer = delayed.empty() ? TimePoint::max() : delayed.top().deliverAt;
+            delayTimerUnclaimed = false;
+        }
+
+        // Retention may have trimmed to make room, as for a push
+        if (appended && trimsOnAppend)
+            spaceFreed();
+        return next;
+    }
+
+    static bool isDelayed(const PushOptions &options)
+    {
+        return options.deliverAt != TimePoint() && options.deliverAt > chrono::steady_clock::now();
+    }
+
+    // Service only when delayed: it must then claim and schedule the timer
+    PushResult pushTo(size_t partition, Message msg, const PushOptions &options)
+    {
+        PushResult result = admit(1, msg.content.size());
+        if (result != ACCEPTED)
+            return result;
+
+        size_t lane = min(options.priority, laneCount - 1);
+        if (isDelayed(options))
+        {
+            lock_guard<mutex> lock(delayMtx);
+            delayedMessages.fetch_add(1, memory_order_relaxed);
+            delayedBytes.fetch_add(msg.content.size(), memory_order_relaxed);
+            delayed.push({options.deliverAt, delayedSeq++, partition, lane, std::move(msg)});
+            if (options.deliverAt < delayTimer)
+            {
+                delayTimer = options.deliverAt;
+                delayTimerUnclaimed = true;
+            }
+            return ACCEPTED;
+        }
+
+        append(partition, lane, std::move(msg));
+        if (trimsOnAppend)
+            spaceFreed();
+        return ACCEPTED;
+    }
+
+public:
+    QueueTopic(string name, chrono::milliseconds ttl, const TopicOptions &options = {}, size_t partitionCount = 1)
+        : name(name), laneCount(max<size_t>(options.priorityLanes, 1)), quotaBytes(options.quotaBytes), quotaMessages(options.quotaMessages),
+          overflow(options.overflow), blockTimeout(options.blockTimeout),
+          trimsOnAppend(options.retentionBytes || options.retentionMessages || options.storage == RING)
+    {
+        if (options.storage == SEGMENTED_LOG)
+            ::mkdir(options.dir.c_str(), 0755);
+
+        Retention retention{ttl, options.retentionBytes, options.retentionMessages};
+
+        // Lane 0 of partition p lives in dir/<name>-<p>, lane l in dir/<name>-<p>-<l>
+        auto makeStorage = [&](size_t p, size_t lane) -> unique_ptr<TopicStorage>
+        {
+            string suffix = to_string(p) + (lane ? "-" + to_string(lane) : "");
+            if (options.storage == SEGMENTED_LOG)
+                return make_unique<SegmentedLog>(options.dir + "/" + name + "-" + suffix, retention,
+                                                 options.segmentBytes);
+            if (options.storage == BATCHED)
+                return make_unique<BatchStorage>(retention, options.compression, options.batchMessages,
+                                                 options.batchBytes);
+            if (options.storage == RING)
+                return make_unique<RingStorage>(retention, options.ringCapacity);
+            return make_unique<MemoryStorage>(retention);
+        };
+
+        partitionCount = max<size_t>(partitionCount, 1);
+        for (size_t p = 0; p < partitionCount; p++)
+            partitions.push_back(makeStorage(p, 0));
+        for (size_t lane = 1; lane < laneCount; lane++)
+            for (size_t p = 0; p < partitionCount; p++)
+                lanes.push_back(makeStorage(p, lane));
+
+        waiters = make_unique<OffsetWaiters[]>(partitionCount);
+        laneWaiters = make_unique<OffsetWaiters[]>(partitionCount);
+    }
+
+    size_t partitionCount() const
+    {
+        return partitions.size();
+    }
+
+    size_t roundRobin()
+    {
+        return partitions.size() == 1 ? 0 : nextPartition.fetch_add(1, memory_order_relaxed) % partitions.size();
+    }
+
+    size_t partitionFor(string_view key) const
+    {
+        return hash<string_view>()(key) % partitions.size();
+    }
+
+    // Throws invalid_argument for a future deliverAt; see PushOptions
+    PushResult push(size_t partition, Message msg, const PushOptions &options = {})
+    {
+        if (isDelayed(options))
+            throw invalid_argument("delayed delivery needs MessageQueueService");
+        return pushTo(partition, std::move(msg), options);
+    }
+
+    PushResult push(Message msg, const PushOptions &options = {})
+    {
+        return push(roundRobin(), std::move(msg), options);
+    }
+
+    PushResult push(string_view key, Message msg, const PushOptions &options = {})
+    {
+        return push(partitionFor(key), std::move(msg), options);
+    }
+
+    // The messages land in one partition with consecutive offsets
+    PushResult pushBatch(vector<Message> msgs)
+    {
+        PushResult result = admit(msgs.size(), payloadBytes(msgs));
+        if (result != ACCEPTED)
+            return result;
+
+        appendBatch(std::move(msgs));
+        if (trimsOnAppend)
+            spaceFreed();
+        return ACCEPTED;
+    }
+
+    // Never blocks. Under BLOCK a batch that does not fit yet is queued behind
+    // earlier ones; `deadline` is set to when it times out, and
+    // expirePending() must run then. Otherwise the future is already ready.
+    future<PushResult> pushBatchAsync(vector<Message> msgs, TimePoint &deadline)
+    {
+        deadline = TimePoint::max();
+        promise<PushResult> done;
+        future<PushResult> result = done.get_future();
+        size_t bytes = payloadBytes(msgs);
+
+        if (overflow != BLOCK || !limited() || neverFits(msgs.size(), bytes) ||
+            (waiting.load(memory_order_relaxed) == 0 && fits(msgs.size(), bytes)))
+        {
+            done.set_value(pushBatch(std::move(msgs)));
+            return result;
+        }
+
+        lock_guard<mutex> lock(spaceMtx);
+        deadline = chrono::steady_clock::now() + blockTimeout;
+        pending.push_back({std::move(msgs), bytes, deadline, std::move(done)});
+        waiting.fetch_add(1);
+        // Space may have been freed before the batch was queued
+        drainPending();
+        return result;
+    }
+
+    // Fails queued async batches whose deadline has passed
+    void expirePending()
+    {
+        lock_guard<mutex> lock(spaceMtx);
+        drainPending();
+    }
+
+    // Zero-copy: views into the storage, valid while the batch is alive
+    MessageBatch read(size_t partition, size_t &offset, int batchSize)
+    {
+        if (partition >= partitions.size())
+            return {};
+        return partitions[partition]->read(offset, batchSize);
+    }
+
+    MessageBatch read(size_t &offset, int batchSize)
+    {
+        return read(0, offset, batchSize);
+    }
+
+    MessageBatch read(size_t partition, size_t &offset, const ReadOptions &options)
+    {
+        if (partition >= partitions.size())
+            return {};
+
+        TopicStorage &storage = *partitions[partition];
+        auto endOffset = [&]()
+        { return storage.endOffset(); };
+
+        if (waiters[partition].wait(offset + 1, chrono::steady_clock::now() + options.timeout, endOffset))
+            waiters[partition].wait(offset + max(options.minBatch, 1), chrono::steady_clock::now() + options.maxWait,
+                                    endOffset);
+        return storage.read(offset, options.maxBatch);
+    }
+
+    size_t priorityLanes() const
+    {
+        return laneCount;
+    }
+
+    // One lane of a partition, like read(); lane 0 is the partition itself
+    MessageBatch readLane(size_t partition, size_t lane, size_t &offset, int batchSize)
+    {
+        if (partition >= partitions.size() || lane >= laneCount)
+            return {};
+        return storageOf(partition, lane).read(offset, batchSize);
+    }
+
+    // Reads the partition's lanes from the most urgent down, until batchSize
+    // messages are read. laneOffsets holds one read offset per lane (it is
+    // resized to fit) and is advanced like the offset of read(); views carry
+    // the offset within their own lane.
+    MessageBatch readByPriority(size_t partition, vector<size_t> &laneOffsets, int batchSize)
+    {
+        MessageBatch batch;
+        if (partition >= partitions.size())
+            return batch;
+
+        laneOffsets.resize(laneCount, 0);
+        for (size_t lane = laneCount; lane-- > 0 && int(batch.size()) < batchSize;)
+            batch.merge(storageOf(partition, lane).read(laneOffsets[lane], batchSize - int(batch.size())));
+        return batch;
+    }
+
+    // Blocking form, with the waits of ReadOptions counted over all lanes
+    MessageBatch readByPriority(size_t partition, vector<size_t> &laneOffsets, const ReadOptions &options)
+    {
+        if (partition >= partitions.size())
+            return {};
+
+        laneOffsets.resize(laneCount, 0);
+        size_t readSum = accumulate(laneOffsets.begin(), laneOffsets.end(), size_t(0));
+        auto endSum = [&]()
+        { return laneEndSum(partition); };
+
+        OffsetWaiters &w = laneCount > 1 ? laneWaiters[partition] : waiters[partition];
+        if (w.wait(readSum + 1, chrono::steady_clock::now() + options.timeout, endSum))
+            w.wait(readSum + max(options.minBatch, 1), chrono::steady_clock::now() + options.maxWait, endSum);
+        return readByPriority(partition, laneOffsets, options.maxBatch);
+    }
+
+    // Releases blocked readers; later blocking reads return immediately
+    void close()
+    {
+        for (size_t p = 0; p < partitions.size(); p++)
+        {
+            waiters[p].close();
+            laneWaiters[p].close();
+        }
+
+        lock_guard<mutex> lock(spaceMtx);
+        closed = true;
+        drainPending();
+        spaceCv.notify_all();
+    }
+
+    vector<Message> get(size_t &offset, int batchSize)
+    {
+        vector<Message> msgs;
+        for (auto &view : read(offset, batchSize))
+            msgs.push_back({string(view.content)});
+        return msgs;
+    }
+
+    size_t endOffset(size_t partition, size_t lane = 0)
+    {
+        return partition < partitions.size() && lane < laneCount ? storageOf(partition, lane).endOffset() : 0;
+    }
+
+    // Summed over partitions and lanes, delayed messages included; this is
+    // what the quota is checked against
+    StorageUsage usage()
+    {
+        StorageUsage total{delayedMessages.load(memory_order_relaxed), delayedBytes.load(memory_order_relaxed)};
+        forEachStorage([&](TopicStorage &storage)
+                       {
+            StorageUsage used = storage.usage();
+            total.messages += used.messages;
+            total.bytes += used.bytes; });
+        return total;
+    }
+
+    // Earliest head expiry over all partitions
+    TimePoint nextExpiry()
+    {
+        TimePoint earliest = TimePoint::max();
+        forEachStorage([&](TopicStorage &storage)
+                       { earliest = min(earliest, storage.nextExpiry()); });
+        return earliest;
+    }
+
+    // True for the one caller that should add the topic to the expiry queue
+    bool claimExpiry()
+    {
+        return !expiryScheduled.load(memory_order_relaxed) && !expiryScheduled.exchange(true);
+    }
+
+    void releaseExpiry()
+    {
+        expiryScheduled.store(false);
+    }
+
+    void cleanup()
+    {
+        forEachStorage([](TopicStorage &storage)
+                       { storage.cleanup(); });
+        spaceFreed();
+    }
+};
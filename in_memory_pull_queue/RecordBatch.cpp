@@ -0,0 +1,323 @@
+#include "bits/stdc++.h"
+#include "Codec.cpp"
+#include "TopicStorage.cpp"
+
+using namespace std;
+
+#pragma once
+
+static void putVarint(string &out, uint64_t v)
+{
+    for (; v >= 0x80; v >>= 7)
+        out.push_back(char(v | 0x80));
+    out.push_back(char(v));
+}
+
+static uint64_t getVarint(string_view in, size_t &p)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p >= in.size())
+            throw runtime_error("corrupt batch");
+        unsigned char byte = in[p++];
+        v |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return v;
+    }
+    throw runtime_error("corrupt batch");
+}
+
+// Messages appended since the last seal, kept as plain strings so they are
+// readable at once. Slots below count never change.
+struct OpenBatch
+{
+    size_t capacity;
+    unique_ptr<string[]> contents;
+    unique_ptr<int64_t[]> timestamps;
+
+    explicit OpenBatch(size_t capacity)
+        : capacity(capacity), contents(new string[capacity]), timestamps(new int64_t[capacity]) {}
+};
+
+struct DecodedBatch
+{
+    string raw;
+    vector<string_view> payloads;
+};
+
+// An immutable, compressed run of records. Record i has offset
+// baseOffset + i, so ids take no space. Each record is
+// zigzag(timestamp - baseTimestamp) | length | payload, with varint fields.
+class RecordBatch
+{
+private:
+    mutable mutex decodeMtx;
+    mutable weak_ptr<const DecodedBatch> cached;
+
+public:
+    uint32_t count;
+    int64_t baseTimestampMs;
+    uint32_t rawSize;
+    string data;
+
+    RecordBatch(const OpenBatch &open, uint32_t count, const Codec &codec) : count(count)
+    {
+        baseTimestampMs = open.timestamps[0];
+        string raw;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            int64_t delta = open.timestamps[i] - baseTimestampMs;
+            putVarint(raw, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+            putVarint(raw, open.contents[i].size());
+            raw += open.contents[i];
+        }
+        rawSize = raw.size();
+        codec.compress(raw, data);
+        data.shrink_to_fit();
+    }
+
+    // Decompressed lazily; concurrent readers share one copy while any holds it
+    shared_ptr<const DecodedBatch> decode(const Codec &codec) const
+    {
+        lock_guard<mutex> lock(decodeMtx);
+        if (auto decoded = cached.lock())
+            return decoded;
+
+        auto decoded = make_shared<DecodedBatch>();
+        codec.decompress(data, rawSize, decoded->raw);
+        string_view raw = decoded->raw;
+        size_t p = 0;
+        decoded->payloads.reserve(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            getVarint(raw, p);
+            size_t length = getVarint(raw, p);
+            if (p + length > raw.size())
+                throw runtime_error("corrupt batch");
+            decoded->payloads.push_back(raw.substr(p, length));
+            p += length;
+        }
+        cached = decoded;
+        return decoded;
+    }
+};
+
+// Groups appends into record batches and seals each one, compressed, once it
+// reaches batchMessages or batchBytes. appendBatch() seals what it is given
+// as a single batch. Compression runs outside the lock, and the batch stays
+// readable in its open form until then. Retention drops whole batches.
+class BatchStorage : public TopicStorage
+{
+private:
+    struct Entry
+    {
+        size_t baseOffset;
+        size_t count;
+        size_t bytes; // payload bytes while open, compressed size once sealed
+        int64_t maxTimestampMs;
+        shared_ptr<OpenBatch> open;
+        shared_ptr<const RecordBatch> sealed;
+    };
+
+    Retention retention;
+    unique_ptr<Codec> codec;
+    size_t batchMessages, batchBytes;
+
+    mutex mtx;
+    deque<Entry> entries;
+    bool appending = false; // entries.back() still takes appends
+    size_t nextOffset = 0;
+    size_t bytes = 0;
+
+    bool overLimit() const
+    {
+        return (retention.maxBytes && bytes > retention.maxBytes) ||
+               (retention.maxMessages && nextOffset - entries.front().baseOffset > retention.maxMessages);
+    }
+
+    void publish()
+    {
+        publishUsage(entries.empty() ? 0 : nextOffset - entries.front().baseOffset, bytes);
+    }
+
+    void dropOldest()
+    {
+        if (entries.size() == 1)
+            appending = false;
+        bytes -= entries.front().bytes;
+        entries.pop_front();
+    }
+
+    // Called with the lock held; the caller seals the returned batch after unlocking
+    shared_ptr<OpenBatch> closeOpen(size_t &baseOffset, size_t &count)
+    {
+        if (!appending)
+            return nullptr;
+        appending = false;
+        baseOffset = entries.back().baseOffset;
+        count = entries.back().count;
+        return entries.back().open;
+    }
+
+    void seal(shared_ptr<OpenBatch> open, size_t baseOffset, size_t count)
+    {
+        if (!open)
+            return;
+        auto sealed = make_shared<const RecordBatch>(*open, count, *codec);
+
+        lock_guard<mutex> lock(mtx);
+        auto it = lower_bound(entries.begin(), entries.end(), baseOffset, [](const Entry &e, size_t offset)
+                              { return e.baseOffset < offset; });
+        if (it == entries.end() || it->baseOffset != baseOffset)
+            return; // dropped by retention meanwhile
+        bytes = bytes - it->bytes + sealed->data.size();
+        it->bytes = sealed->data.size();
+        it->sealed = std::move(sealed);
+        it->open.reset();
+        publish();
+    }
+
+public:
+    BatchStorage(Retention retention, CompressionType compression, size_t batchMessages, size_t batchBytes)
+        : retention(retention), codec(makeCodec(compression)), batchMessages(max<size_t>(batchMessages, 1)),
+          batchBytes(batchBytes) {}
+
+    void append(Message msg) override
+    {
+        int64_t now = unixNowMs();
+        shared_ptr<OpenBatch> full;
+        size_t fullBase = 0, fullCount = 0;
+        {
+            lock_guard<mutex> lock(mtx);
+            if (!appending)
+            {
+                entries.push_back({nextOffset, 0, 0, now, make_shared<OpenBatch>(batchMessages), nullptr});
+                appending = true;
+            }
+
+            Entry &entry = entries.back();
+            entry.open->timestamps[entry.count] = now;
+            entry.open->contents[entry.count] = std::move(msg.content);
+            entry.bytes += entry.open->contents[entry.count].size();
+            bytes += entry.open->contents[entry.count].size();
+            entry.maxTimestampMs = max(entry.maxTimestampMs, now);
+            entry.count++;
+            nextOffset++;
+
+            if (entry.count == batchMessages || entry.bytes >= batchBytes)
+                full = closeOpen(fullBase, fullCount);
+            while (entries.size() > 1 && overLimit())
+                dropOldest();
+            publish();
+        }
+        seal(std::move(full), fullBase, fullCount);
+    }
+
+    void appendBatch(vector<Message> msgs) override
+    {
+        if (msgs.empty())
+            return;
+
+        int64_t now = unixNowMs();
+        auto batch = make_shared<OpenBatch>(msgs.size());
+        size_t payloadBytes = 0;
+        for (size_t i = 0; i < msgs.size(); i++)
+        {
+            batch->timestamps[i] = now;
+            payloadBytes += msgs[i].content.size();
+            batch->contents[i] = std::move(msgs[i].content);
+        }
+
+        shared_ptr<OpenBatch> previous;
+        size_t previousBase = 0, previousCount = 0, base;
+        {
+            lock_guard<mutex> lock(mtx);
+            previous = closeOpen(previousBase, previousCount);
+            base = nextOffset;
+            entries.push_back({base, msgs.size(), payloadBytes, now, batch, nullptr});
+            bytes += payloadBytes;
+            nextOffset += msgs.size();
+            while (entries.size() > 1 && overLimit())
+                dropOldest();
+            publish();
+        }
+        seal(std::move(previous), previousBase, previousCount);
+        seal(std::move(batch), base, msgs.size());
+    }
+
+    MessageBatch read(size_t &offset, int batchSize) override
+    {
+        MessageBatch batch;
+        vector<Entry> range;
+        size_t end;
+        {
+            lock_guard<mutex> lock(mtx);
+            offset = max(offset, entries.empty() ? nextOffset : entries.front().baseOffset);
+            end = min(offset + max(batchSize, 0), nextOffset);
+            if (offset >= end)
+                return batch;
+
+            auto it = prev(upper_bound(entries.begin(), entries.end(), offset, [](size_t o, const Entry &e)
+                                       { return o < e.baseOffset; }));
+            for (; it != entries.end() && it->baseOffset < end; it++)
+                range.push_back(*it);
+        }
+
+        batch.reserve(end - offset);
+        for (auto &entry : range)
+        {
+            size_t entryEnd = min(end, entry.baseOffset + entry.count);
+            if (entry.sealed)
+            {
+                auto decoded = entry.sealed->decode(*codec);
+                for (; offset < entryEnd; offset++)
+                    batch.add(offset, decoded->payloads[offset - entry.baseOffset]);
+                batch.pin(std::move(decoded));
+            }
+            else
+            {
+                for (; offset < entryEnd; offset++)
+                    batch.add(offset, entry.open->contents[offset - entry.baseOffset]);
+                batch.pin(std::move(entry.open));
+            }
+        }
+        return batch;
+    }
+
+    size_t endOffset() override
+    {
+        lock_guard<mutex> lock(mtx);
+        return nextOffset;
+    }
+
+    TimePoint nextExpiry() override
+    {
+        lock_guard<mutex> lock(mtx);
+        if (entries.empty())
+            return TimePoint::max();
+        return steadyFromUnixMs(entries.front().maxTimestampMs + retention.ttl.count());
+    }
+
+    void cleanup() override
+    {
+        int64_t expiredBefore = unixNowMs() - retention.ttl.count();
+        lock_guard<mutex> lock(mtx);
+        while (!entries.empty() && entries.front().maxTimestampMs < expiredBefore)
+            dropOldest();
+        publish();
+    }
+
+    void dropFront(size_t messages, size_t minBytes) override
+    {
+        lock_guard<mutex> lock(mtx);
+        size_t droppedMessages = 0, droppedBytes = 0;
+        while (entries.size() > 1 && (droppedMessages < messages || droppedBytes < minBytes))
+        {
+            droppedMessages += entries.front().count;
+            droppedBytes += entries.front().bytes;
+            dropOldest();
+        }
+        publish();
+    }
+};
@@ -0,0 +1,341 @@
+#include "bits/stdc++.h"
+#include "Epoch.cpp"
+#include "TopicStorage.cpp"
+
+using namespace std;
+
+#pragma once
+
+// Lock-free chunked ring. A producer takes a ticket from `tail`; the ticket
+// is the message's offset and names its chunk and slot. Slots are published
+// with a release flag, and consumers read them without locking. A chunk sits
+// in table[index % tableSize]. Chunks leave the table in two ways: cleanup
+// moves `head` past them (TTL or byte retention), or the ring wraps and drops
+// its oldest chunk. A removed chunk is retired to the epoch domain's shared
+// list, which cleanup() and the trimming producer collect, and is freed once
+// the last reader pinning it lets go.
+class RingStorage : public TopicStorage
+{
+public:
+    static constexpr size_t CHUNK_SLOTS = 1024;
+
+private:
+    static constexpr size_t RETIRED = SIZE_MAX;
+
+    struct Slot
+    {
+        atomic<bool> published{false};
+        TimePoint validTill;
+        string content;
+    };
+
+    struct Chunk
+    {
+        const size_t index;
+        // The table holds one reference; each batch reading the chunk holds one more
+        atomic<size_t> refs{1};
+        // RETIRED once the chunk left the table and its bytes were uncounted
+        atomic<size_t> bytes{0};
+        Slot slots[CHUNK_SLOTS];
+
+        explicit Chunk(size_t index) : index(index) {}
+
+        void unref()
+        {
+            if (refs.fetch_sub(1, memory_order_acq_rel) == 1)
+                delete this;
+        }
+    };
+
+    Retention retention;
+    size_t tableSize;
+    unique_ptr<atomic<Chunk *>[]> table;
+
+    alignas(64) atomic<size_t> tail{0};
+    alignas(64) atomic<size_t> head{0};
+    atomic<size_t> bytes{0}; // payload bytes in chunks still in the table
+
+    // Serialises moving head for retention; producers only try it
+    mutex trimMtx;
+    size_t retiredChunks = 0;
+    // Set while retired chunks may still be waiting on the shared list
+    atomic<bool> reclaimPending{false};
+
+    static void advance(atomic<size_t> &offset, size_t to)
+    {
+        size_t current = offset.load();
+        while (current < to && !offset.compare_exchange_weak(current, to))
+            ;
+    }
+
+    // Drops the table's reference once no reader can still be looking it up
+    void retire(Chunk *chunk)
+    {
+        // Producers that add after this see RETIRED and take their bytes back
+        bytes.fetch_sub(chunk->bytes.exchange(RETIRED));
+        EpochDomain::global().retireShared(chunk, [](void *p)
+                                           { static_cast<Chunk *>(p)->unref(); });
+        reclaimPending.store(true, memory_order_relaxed);
+    }
+
+    // trimMtx held
+    void retireBelowHead()
+    {
+        size_t firstChunk = head.load() / CHUNK_SLOTS;
+        for (retiredChunks = max(retiredChunks, firstChunk >= tableSize ? firstChunk - tableSize : 0);
+             retiredChunks < firstChunk; retiredChunks++)
+        {
+            atomic<Chunk *> &cell = table[retiredChunks % tableSize];
+            Chunk *chunk = cell.load();
+            if (chunk && chunk->index == retiredChunks && cell.compare_exchange_strong(chunk, nullptr))
+                retire(chunk);
+        }
+    }
+
+    // trimMtx held. False if the oldest chunk is the one being written.
+    bool dropOldestChunk()
+    {
+        size_t oldest = head.load() / CHUNK_SLOTS;
+        if (oldest >= tail.load() / CHUNK_SLOTS)
+            return false;
+        advance(head, (oldest + 1) * CHUNK_SLOTS);
+        retireBelowHead();
+        return true;
+    }
+
+    // trimMtx held
+    void trimToBytes()
+    {
+        while (bytes.load() > retention.maxBytes && dropOldestChunk())
+            ;
+    }
+
+    bool belowHead(size_t index) const
+    {
+        return index < head.load() / CHUNK_SLOTS;
+    }
+
+    // Caller holds an epoch guard. Null if the chunk was overwritten by a
+    // wrap or already dropped.
+    Chunk *chunkForWrite(size_t index)
+    {
+        atomic<Chunk *> &cell = table[index % tableSize];
+        Chunk *current = cell.load(memory_order_acquire);
+        Chunk *created = nullptr;
+
+        while (!current || current->index < index)
+        {
+            // Cleanup dropped it before it was ever created, and
+            // retireBelowHead will not come back for it
+            if (belowHead(index))
+            {
+                delete created;
+                return nullptr;
+            }
+
+            if (!created)
+            {
+                created = new Chunk(index);
+                // Wrapping drops the oldest chunk; readers must skip past it first
+                if (index >= tableSize)
+                    advance(head, (index - tableSize + 1) * CHUNK_SLOTS);
+            }
+
+            Chunk *replaced = current;
+            if (cell.compare_exchange_weak(current, created))
+            {
+                if (replaced)
+                    retire(replaced);
+                // head may have passed it meanwhile; whichever of us and
+                // retireBelowHead clears the cell retires it
+                if (belowHead(index))
+                {
+                    Chunk *installed = created;
+                    if (cell.compare_exchange_strong(installed, nullptr))
+                        retire(created);
+                    return nullptr;
+                }
+                return created;
+            }
+        }
+
+        delete created;
+        return current->index == index ? current : nullptr;
+    }
+
+    // Caller holds an epoch guard. Null if the chunk is not installed yet or is gone.
+    Chunk *chunkForRead(size_t index)
+    {
+        Chunk *chunk = table[index % tableSize].load(memory_order_acquire);
+        return chunk && chunk->index == index ? chunk : nullptr;
+    }
+
+public:
+    // Retains at most capacity messages (or retention.maxMessages if lower),
+    // rounded up to whole chunks
+    RingStorage(Retention retention, size_t capacity = 1 << 20)
+        : retention(retention),
+          tableSize(max<size_t>((min(capacity, retention.maxMessages ? retention.maxMessages : capacity) +
+                                 CHUNK_SLOTS - 1) / CHUNK_SLOTS, 2)),
+          table(new atomic<Chunk *>[tableSize])
+    {
+        for (size_t i = 0; i < tableSize; i++)
+            table[i].store(nullptr);
+    }
+
+    ~RingStorage()
+    {
+        for (size_t i = 0; i < tableSize; i++)
+            if (Chunk *chunk = table[i].load())
+                chunk->unref();
+    }
+
+    void append(Message msg) override
+    {
+        size_t ticket = tail.fetch_add(1);
+        EpochGuard guard;
+
+        // Lost only if the ring lapped this producer between ticket and publish
+        Chunk *chunk = chunkForWrite(ticket / CHUNK_SLOTS);
+        if (!chunk)
+            return;
+
+        Slot &slot = chunk->slots[ticket % CHUNK_SLOTS];
+        size_t size = msg.content.size();
+        slot.content = std::move(msg.content);
+        slot.validTill = chrono::steady_clock::now() + retention.ttl;
+        slot.published.store(true, memory_order_release);
+
+        // Counted globally first, so retire() never subtracts bytes that are
+        // not in the total yet
+        size_t total = bytes.fetch_add(size) + size;
+        size_t chunkBytes = chunk->bytes.load(memory_order_relaxed);
+        do
+        {
+            if (chunkBytes == RETIRED)
+            {
+                bytes.fetch_sub(size);
+                return;
+            }
+        } while (!chunk->bytes.compare_exchange_weak(chunkBytes, chunkBytes + size, memory_order_relaxed));
+
+        if (retention.maxBytes && total > retention.maxBytes)
+        {
+            unique_lock<mutex> lock(trimMtx, try_to_lock);
+            if (lock.owns_lock())
+                trimToBytes();
+        }
+
+        // A collect moves the epoch at most one step, so a retired chunk
+        // takes a few appends (or cleanups) to be freed; keep trying until
+        // nothing is left
+        if (reclaimPending.load(memory_order_relaxed) && reclaimPending.exchange(false) &&
+            !EpochDomain::global().collect())
+            reclaimPending.store(true, memory_order_relaxed);
+    }
+
+    // Stops at the first reserved but unpublished slot, so offsets are never skipped
+    MessageBatch read(size_t &offset, int batchSize) override
+    {
+        MessageBatch batch;
+        EpochGuard guard;
+
+        offset = max(offset, head.load());
+        size_t end = min(offset + max(batchSize, 0), tail.load());
+        Chunk *pinned = nullptr;
+        batch.reserve(end > offset ? end - offset : 0);
+
+        while (offset < end)
+        {
+            Chunk *chunk = chunkForRead(offset / CHUNK_SLOTS);
+            if (!chunk)
+            {
+                // Cleaned up or lapped: resume at the oldest retained message
+                size_t oldest = head.load();
+                if (oldest <= offset)
+                    break;
+                offset = oldest;
+                continue;
+            }
+
+            Slot &slot = chunk->slots[offset % CHUNK_SLOTS];
+            if (!slot.published.load(memory_order_acquire))
+                break;
+
+            if (chunk != pinned)
+            {
+                // The guard keeps the chunk alive until the batch holds its own reference
+                chunk->refs.fetch_add(1, memory_order_relaxed);
+                batch.pin(shared_ptr<const void>(chunk, [](const void *p)
+                                                 { static_cast<Chunk *>(const_cast<void *>(p))->unref(); }));
+                pinned = chunk;
+            }
+            batch.add(offset, slot.content);
+            offset++;
+        }
+        return batch;
+    }
+
+    // Includes reserved slots that are not yet published
+    size_t endOffset() override
+    {
+        return tail.load();
+    }
+
+    TimePoint nextExpiry() override
+    {
+        EpochGuard guard;
+        size_t first = head.load();
+        if (first >= tail.load())
+            return TimePoint::max();
+
+        // A message still being published expires about a TTL from now
+        Chunk *chunk = chunkForRead(first / CHUNK_SLOTS);
+        if (!chunk || !chunk->slots[first % CHUNK_SLOTS].published.load(memory_order_acquire))
+            return chrono::steady_clock::now() + retention.ttl;
+        return chunk->slots[first % CHUNK_SLOTS].validTill;
+    }
+
+    // Never blocks producers or readers
+    void cleanup() override
+    {
+        lock_guard<mutex> lock(trimMtx);
+        auto now = chrono::steady_clock::now();
+        size_t first = head.load(), end = tail.load();
+        {
+            EpochGuard guard;
+            while (first < end)
+            {
+                Chunk *chunk = chunkForRead(first / CHUNK_SLOTS);
+                if (!chunk)
+                    break;
+                Slot &slot = chunk->slots[first % CHUNK_SLOTS];
+                if (!slot.published.load(memory_order_acquire) || slot.validTill >= now)
+                    break;
+                first++;
+            }
+        }
+        advance(head, first);
+        retireBelowHead();
+        // Producers only try the lock, so catch up on any trim they skipped
+        if (retention.maxBytes)
+            trimToBytes();
+        EpochDomain::global().collect();
+    }
+
+    void dropFront(size_t messages, size_t minBytes) override
+    {
+        lock_guard<mutex> lock(trimMtx);
+        size_t target = head.load() + messages, bytesBefore = bytes.load();
+        while ((head.load() < target || bytes.load() + minBytes > bytesBefore) && dropOldestChunk())
+            ;
+    }
+
+    // Reserved slots count as retained
+    StorageUsage usage() override
+    {
+        size_t first = head.load(memory_order_relaxed);
+        size_t end = tail.load(memory_order_relaxed);
+        return {end > first ? end - first : 0, bytes.load(memory_order_relaxed)};
+    }
+};
@@ -0,0 +1,330 @@
+#include "bits/stdc++.h"
+#include "TopicStorage.cpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#pragma once
+
+// A preallocated file mapped read/write, named after the offset of its first
+// message. Records are `length u32 | unix ms i64 | payload` back to back; the
+// file is zero-filled, so a zero length marks the end. The length is written
+// last, which keeps a crash mid-append from leaving a half record behind.
+//
+// Everything but the mapped bytes is guarded by the owning log's mutex.
+class Segment
+{
+public:
+    static constexpr size_t RECORD_HEADER = 12;
+    static constexpr size_t INDEX_INTERVAL = 4096;
+
+    const size_t baseOffset;
+    const string path;
+
+    size_t count = 0;
+    size_t writePos = 0;
+    int64_t lastTimestampMs = 0;
+
+private:
+    int fd;
+    char *data;
+    size_t capacity;
+
+    // Sparse index: (offset - baseOffset, position) about every INDEX_INTERVAL bytes
+    vector<pair<uint32_t, uint32_t>> index;
+    size_t lastIndexedPos = 0;
+
+    uint32_t lengthAt(size_t pos) const
+    {
+        uint32_t length;
+        memcpy(&length, data + pos, 4);
+        return length;
+    }
+
+    void indexRecord(size_t pos)
+    {
+        if (index.empty() || pos - lastIndexedPos >= INDEX_INTERVAL)
+        {
+            index.push_back({uint32_t(count), uint32_t(pos)});
+            lastIndexedPos = pos;
+        }
+    }
+
+    // Rebuilds count, index and write position from the file's records
+    void recover()
+    {
+        while (writePos + RECORD_HEADER <= capacity)
+        {
+            uint32_t length = lengthAt(writePos);
+            if (length == 0 || writePos + RECORD_HEADER + length > capacity)
+                break;
+            indexRecord(writePos);
+            memcpy(&lastTimestampMs, data + writePos + 4, 8);
+            writePos += RECORD_HEADER + length;
+            count++;
+        }
+    }
+
+public:
+    // Opens path, creating it with the given capacity if it does not exist
+    Segment(const string &path, size_t baseOffset, size_t capacity)
+        : baseOffset(baseOffset), path(path), capacity(capacity)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw runtime_error("cannot open " + path + ": " + strerror(errno));
+
+        struct stat st;
+        ::fstat(fd, &st);
+        bool existing = st.st_size > 0;
+        if (existing)
+            this->capacity = st.st_size;
+        else if (::ftruncate(fd, capacity) < 0)
+            throw runtime_error("cannot size " + path + ": " + strerror(errno));
+
+        void *mapped = ::mmap(nullptr, this->capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+            throw runtime_error("cannot map " + path + ": " + strerror(errno));
+        data = static_cast<char *>(mapped);
+
+        if (existing)
+            recover();
+    }
+
+    Segment(const Segment &) = delete;
+    Segment &operator=(const Segment &) = delete;
+
+    // Readers pin segments with shared_ptrs, so this may run after the file
+    // was unlinked; the mapping keeps the pages alive until here
+    ~Segment()
+    {
+        ::munmap(data, capacity);
+        ::close(fd);
+    }
+
+    static string fileName(size_t baseOffset)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%020zu.log", baseOffset);
+        return name;
+    }
+
+    static size_t recordSize(size_t payload)
+    {
+        return RECORD_HEADER + payload;
+    }
+
+    bool fits(size_t payload) const
+    {
+        // Keep room for the zero length that terminates the segment
+        return writePos + recordSize(payload) + 4 <= capacity;
+    }
+
+    void append(string_view payload, int64_t timestampMs)
+    {
+        uint32_t length = payload.size();
+        indexRecord(writePos);
+        memcpy(data + writePos + 4, &timestampMs, 8);
+        memcpy(data + writePos + RECORD_HEADER, payload.data(), payload.size());
+        memcpy(data + writePos, &length, 4);
+        writePos += recordSize(length);
+        lastTimestampMs = timestampMs;
+        count++;
+    }
+
+    // Byte position of offset, which must lie in [baseOffset, baseOffset + count)
+    size_t positionOf(size_t offset) const
+    {
+        uint32_t relative = offset - baseOffset;
+        auto it = upper_bound(index.begin(), index.end(), make_pair(relative, numeric_limits<uint32_t>::max()));
+        size_t at = prev(it)->first;
+        size_t pos = prev(it)->second;
+        for (; at < relative; at++)
+            pos += recordSize(lengthAt(pos));
+        return pos;
+    }
+
+    // Payload of the record at pos; advances pos to the next record
+    string_view payloadAt(size_t &pos) const
+    {
+        uint32_t length = lengthAt(pos);
+        string_view payload(data + pos + RECORD_HEADER, length);
+        pos += recordSize(length);
+        return payload;
+    }
+};
+
+// Append-only sequence of segment files in one directory. Reads hand out
+// views straight into the mapped files (page cache, no copy); retention
+// deletes whole segments, once their newest message is past the TTL or while
+// the log is over its byte or message limit.
+class SegmentedLog : public TopicStorage
+{
+private:
+    string dir;
+    Retention retention;
+    size_t segmentBytes;
+
+    mutex mtx;
+    deque<shared_ptr<Segment>> segments;
+    size_t nextOffset = 0;
+    size_t bytes = 0; // record bytes across all segments
+
+    void roll(size_t minCapacity)
+    {
+        // An empty segment shares its name with the next one; replace it
+        if (!segments.empty() && segments.back()->count == 0)
+        {
+            ::unlink(segments.back()->path.c_str());
+            segments.pop_back();
+        }
+        segments.push_back(make_shared<Segment>(dir + "/" + Segment::fileName(nextOffset), nextOffset,
+                                                max(segmentBytes, minCapacity)));
+    }
+
+    // Readers still pinning the segment keep its mapping
+    void dropOldest()
+    {
+        ::unlink(segments.front()->path.c_str());
+        bytes -= segments.front()->writePos;
+        segments.pop_front();
+    }
+
+    void publish()
+    {
+        publishUsage(segments.empty() ? 0 : nextOffset - segments.front()->baseOffset, bytes);
+    }
+
+    bool overLimit() const
+    {
+        return (retention.maxBytes && bytes > retention.maxBytes) ||
+               (retention.maxMessages && nextOffset - segments.front()->baseOffset > retention.maxMessages);
+    }
+
+public:
+    SegmentedLog(const string &dir, Retention retention, size_t segmentBytes)
+        : dir(dir), retention(retention), segmentBytes(segmentBytes)
+    {
+        ::mkdir(dir.c_str(), 0755);
+
+        vector<size_t> bases;
+        if (DIR *d = ::opendir(dir.c_str()))
+        {
+            while (dirent *e = ::readdir(d))
+            {
+                string name = e->d_name;
+                if (name.size() == 24 && name.compare(20, 4, ".log") == 0)
+                    bases.push_back(stoull(name.substr(0, 20)));
+            }
+            ::closedir(d);
+        }
+        sort(bases.begin(), bases.end());
+
+        for (size_t base : bases)
+        {
+            segments.push_back(make_shared<Segment>(dir + "/" + Segment::fileName(base), base, segmentBytes));
+            bytes += segments.back()->writePos;
+        }
+        if (!segments.empty())
+            nextOffset = segments.back()->baseOffset + segments.back()->count;
+        publish();
+    }
+
+    void append(Message msg) override
+    {
+        int64_t now = unixNowMs();
+        lock_guard<mutex> lock(mtx);
+        if (segments.empty() || !segments.back()->fits(msg.content.size()))
+            roll(Segment::recordSize(msg.content.size()) + 4);
+        segments.back()->append(msg.content, now);
+        bytes += Segment::recordSize(msg.content.size());
+        nextOffset++;
+
+        // The active segment is never dropped
+        while (segments.size() > 1 && overLimit())
+            dropOldest();
+        publish();
+    }
+
+    // The lock covers finding the first record; the copy-free walk over the
+    // mapped records happens after it is released
+    MessageBatch read(size_t &offset, int batchSize) override
+    {
+        MessageBatch batch;
+        vector<pair<shared_ptr<Segment>, size_t>> range;
+        size_t pos, end;
+        {
+            lock_guard<mutex> lock(mtx);
+            if (segments.empty() || batchSize <= 0)
+                return batch;
+
+            offset = max(offset, segments.front()->baseOffset);
+            end = min(offset + batchSize, nextOffset);
+            if (offset >= end)
+                return batch;
+
+            auto it = upper_bound(segments.begin(), segments.end(), offset, [](size_t o, const shared_ptr<Segment> &s)
+                                  { return o < s->baseOffset; });
+            it = prev(it);
+            pos = (*it)->positionOf(offset);
+            for (; it != segments.end() && (*it)->baseOffset < end; it++)
+                range.push_back({*it, (*it)->baseOffset + (*it)->count});
+        }
+
+        batch.reserve(end - offset);
+        for (auto &[segment, segmentEnd] : range)
+        {
+            batch.pin(segment);
+            for (; offset < end && offset < segmentEnd; offset++)
+                batch.add(offset, segment->payloadAt(pos));
+            pos = 0;
+        }
+        return batch;
+    }
+
+    size_t endOffset() override
+    {
+        lock_guard<mutex> lock(mtx);
+        return nextOffset;
+    }
+
+    TimePoint nextExpiry() override
+    {
+        lock_guard<mutex> lock(mtx);
+        if (segments.empty() || !segments.front()->count)
+            return TimePoint::max();
+        return steadyFromUnixMs(segments.front()->lastTimestampMs + retention.ttl.count());
+    }
+
+    void cleanup() override
+    {
+        int64_t expiredBefore = unixNowMs() - retention.ttl.count();
+        lock_guard<mutex> lock(mtx);
+
+        while (!segments.empty() && segments.front()->count && segments.front()->lastTimestampMs < expiredBefore)
+            dropOldest();
+
+        // An empty segment keeps the next offset on disk across restarts
+        if (segments.empty())
+            roll(0);
+        publish();
+    }
+
+    void dropFront(size_t messages, size_t minBytes) override
+    {
+        lock_guard<mutex> lock(mtx);
+        size_t droppedMessages = 0, droppedBytes = 0;
+        while (segments.size() > 1 && (droppedMessages < messages || droppedBytes < minBytes))
+        {
+            droppedMessages += segments.front()->count;
+            droppedBytes += segments.front()->writePos;
+            dropOldest();
+        }
+        publish();
+    }
+};
@@ -0,0 +1,75 @@
+#include "bits/stdc++.h"
+#include "Epoch.cpp"
+#include "QueueTopic.cpp"
+
+using namespace std;
+
+#pragma once
+
+// A resolved topic. Clients may cache it and pass it back to skip the lookup
+using TopicHandle = shared_ptr<QueueTopic>;
+
+// Copy-on-write name -> topic map published through an atomic pointer.
+// Lookups pin an epoch and never lock. add() copies the map under a writer
+// mutex, publishes the copy and retires the old map through the epoch domain.
+// Topics are never removed, so a copy per create is cheap enough.
+class TopicRegistry
+{
+private:
+    using Map = unordered_map<string, TopicHandle>;
+
+    atomic<const Map *> current;
+    mutex writeMtx;
+
+public:
+    TopicRegistry() : current(new Map()) {}
+
+    TopicRegistry(const TopicRegistry &) = delete;
+    TopicRegistry &operator=(const TopicRegistry &) = delete;
+
+    ~TopicRegistry()
+    {
+        delete current.load();
+    }
+
+    // Caller holds an EpochGuard; the result is valid until it is released
+    const TopicHandle *find(const string &name) const
+    {
+        const Map *map = current.load(memory_order_acquire);
+        auto it = map->find(name);
+        return it == map->end() ? nullptr : &it->second;
+    }
+
+    TopicHandle get(const string &name) const
+    {
+        EpochGuard guard;
+        const TopicHandle *topic = find(name);
+        return topic ? *topic : nullptr;
+    }
+
+    // Returns the topic under name and whether make() created it
+    template <typename Make>
+    pair<TopicHandle, bool> add(const string &name, Make make)
+    {
+        lock_guard<mutex> lock(writeMtx);
+        const Map *map = current.load();
+        auto it = map->find(name);
+        if (it != map->end())
+            return {it->second, false};
+
+        auto next = new Map(*map);
+        TopicHandle topic = make();
+        next->emplace(name, topic);
+        current.store(next, memory_order_release);
+        EpochDomain::global().retire(const_cast<Map *>(map));
+        return {topic, true};
+    }
+
+    template <typename F>
+    void forEach(F f) const
+    {
+        EpochGuard guard;
+        for (auto &[name, topic] : *current.load(memory_order_acquire))
+            f(topic);
+    }
+};
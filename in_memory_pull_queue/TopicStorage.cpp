@@ -0,0 +1,217 @@
+#include "bits/stdc++.h"
+#include "Message.cpp"
+
+using namespace std;
+
+#pragma once
+
+enum StorageType
+{
+    MEMORY = 0,
+    SEGMENTED_LOG = 1,
+    RING = 2,
+    BATCHED = 3
+};
+
+// Limits are per partition; 0 means unlimited. Byte and count limits are
+// applied on append, the TTL by cleanup().
+struct Retention
+{
+    chrono::milliseconds ttl;
+    size_t maxBytes = 0;
+    size_t maxMessages = 0;
+};
+
+// What a partition currently retains, in the storage's own byte measure
+struct StorageUsage
+{
+    size_t messages = 0;
+    size_t bytes = 0;
+};
+
+// Where a topic keeps its messages. Offsets are dense and start at 0; read()
+// moves a too-old offset up to the oldest retained message.
+class TopicStorage
+{
+protected:
+    // Published by subclasses after every change, so usage() never locks
+    atomic<size_t> retainedMessages{0};
+    atomic<size_t> retainedBytes{0};
+
+    void publishUsage(size_t messages, size_t bytes)
+    {
+        retainedMessages.store(messages, memory_order_relaxed);
+        retainedBytes.store(bytes, memory_order_relaxed);
+    }
+
+public:
+    virtual void append(Message msg) = 0;
+
+    // Gets consecutive offsets; storages that batch keep it as one batch
+    virtual void appendBatch(vector<Message> msgs)
+    {
+        for (auto &msg : msgs)
+            append(std::move(msg));
+    }
+    virtual MessageBatch read(size_t &offset, int batchSize) = 0;
+
+    // Offset the next append will get
+    virtual size_t endOffset() = 0;
+
+    // When the oldest retained message expires; TimePoint::max() if empty
+    virtual TimePoint nextExpiry() = 0;
+
+    // Drops whatever has outlived the topic's TTL
+    virtual void cleanup() = 0;
+
+    // Drops at least this many messages and bytes from the front if it can,
+    // in the storage's own units; never the part still being appended to
+    virtual void dropFront(size_t messages, size_t bytes) = 0;
+
+    virtual StorageUsage usage()
+    {
+        return {retainedMessages.load(memory_order_relaxed), retainedBytes.load(memory_order_relaxed)};
+    }
+
+    virtual ~TopicStorage() = default;
+};
+
+// Payloads live in fixed-size blocks, so a stored message never moves. A read
+// pins the blocks it spans under the lock and builds its views after
+// releasing it. Messages are dropped one at a time, but memory is only freed
+// once a whole block has been dropped.
+class MemoryStorage : public TopicStorage
+{
+private:
+    static constexpr size_t BLOCK_MESSAGES = 256;
+
+    struct Block
+    {
+        size_t firstId;
+        string contents[BLOCK_MESSAGES];
+        TimePoint validTill[BLOCK_MESSAGES];
+
+        explicit Block(size_t firstId) : firstId(firstId) {}
+    };
+
+    deque<shared_ptr<Block>> blocks;
+    mutex mtx;
+
+    Retention retention;
+
+    // Retained ids are [minId, messageId)
+    size_t minId = 0;
+    size_t messageId = 0;
+    size_t bytes = 0;
+
+    Block &blockOf(size_t id)
+    {
+        return *blocks[id / BLOCK_MESSAGES - blocks.front()->firstId / BLOCK_MESSAGES];
+    }
+
+    template <typename Expired>
+    void dropWhile(Expired expired)
+    {
+        while (minId < messageId)
+        {
+            Block &block = blockOf(minId);
+            if (!expired(block, minId - block.firstId))
+                break;
+            bytes -= block.contents[minId - block.firstId].size();
+            minId++;
+        }
+        while (!blocks.empty() && blocks.front()->firstId + BLOCK_MESSAGES <= minId)
+            blocks.pop_front();
+        publishUsage(messageId - minId, bytes);
+    }
+
+public:
+    MemoryStorage(Retention retention) : retention(retention) {}
+
+    void append(Message msg) override
+    {
+        auto validTill = chrono::steady_clock::now() + retention.ttl;
+        lock_guard<mutex> lock(mtx);
+
+        size_t slot = messageId % BLOCK_MESSAGES;
+        if (slot == 0)
+            blocks.push_back(make_shared<Block>(messageId));
+
+        Block &block = *blocks.back();
+        block.contents[slot] = std::move(msg.content);
+        block.validTill[slot] = validTill;
+        bytes += block.contents[slot].size();
+        messageId++;
+
+        dropWhile([&](Block &, size_t)
+                  { return (retention.maxBytes && bytes > retention.maxBytes) ||
+                           (retention.maxMessages && messageId - minId > retention.maxMessages); });
+    }
+
+    MessageBatch read(size_t &offset, int batchSize) override
+    {
+        MessageBatch batch;
+        vector<shared_ptr<Block>> range;
+        size_t end;
+        {
+            lock_guard<mutex> lock(mtx);
+            offset = max(offset, minId);
+            end = min(offset + max(batchSize, 0), messageId);
+            if (offset >= end)
+                return batch;
+
+            size_t first = offset / BLOCK_MESSAGES - blocks.front()->firstId / BLOCK_MESSAGES;
+            for (size_t b = first; b < blocks.size() && blocks[b]->firstId < end; b++)
+                range.push_back(blocks[b]);
+        }
+
+        // Slots below end were written under the lock before the snapshot and
+        // are not touched again while the block is alive
+        batch.reserve(end - offset);
+        for (auto &block : range)
+        {
+            for (; offset < end && offset < block->firstId + BLOCK_MESSAGES; offset++)
+                batch.add(offset, block->contents[offset - block->firstId]);
+            batch.pin(std::move(block));
+        }
+        return batch;
+    }
+
+    size_t endOffset() override
+    {
+        lock_guard<mutex> lock(mtx);
+        return messageId;
+    }
+
+    TimePoint nextExpiry() override
+    {
+        lock_guard<mutex> lock(mtx);
+        if (minId == messageId)
+            return TimePoint::max();
+        Block &block = blockOf(minId);
+        return block.validTill[minId - block.firstId];
+    }
+
+    void cleanup() override
+    {
+        lock_guard<mutex> lock(mtx);
+        auto now = chrono::steady_clock::now();
+
+        // Efficiently remove only from the front to maintain index integrity
+        dropWhile([&](Block &block, size_t slot)
+                  { return block.validTill[slot] < now; });
+    }
+
+    void dropFront(size_t messages, size_t minBytes) override
+    {
+        lock_guard<mutex> lock(mtx);
+        size_t droppedMessages = 0, droppedBytes = 0;
+        dropWhile([&](Block &block, size_t slot)
+                  {
+            if (droppedMessages >= messages && droppedBytes >= minBytes)
+                return false;
+            droppedMessages++;
+            droppedBytes += block.contents[slot].size();
+            return true; });
+    }
+};
@@ -0,0 +1,699 @@
+#include "bits/stdc++.h"
+#include "MessageQueueService.cpp"
+
+#include <malloc.h>
+
+using namespace std;
+
+// Build: g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+// Usage: ./benchmark [scenario] [durationMs] [--key=value ...]
+//
+// The "service" scenario takes these keys (defaults in BenchConfig):
+//   --topics=N --partitions=N --producers=N --consumers=N
+//   --payload=fixed:64 | uniform:16-1024 | lognormal:256:1.0 (median, sigma)
+//   --ttlMs=N --storage=memory|ring|batched|log --rate=N (msgs/s per producer, 0 = flat out)
+//   --json    one JSON object on stdout, for comparing runs across commits
+
+struct BenchConfig
+{
+    int durationMs = 300;
+
+    int topics = 1;
+    int partitions = 1;
+    int producers = 4;
+    int consumers = 4;
+    string payload = "fixed:64";
+    int ttlMs = 60000;
+    string storage = "memory";
+    int rate = 0;
+    bool json = false;
+};
+
+struct RunResult
+{
+    double pushedPerSec;
+    double deliveredPerSec;
+    uint64_t p99Us;
+};
+
+static int64_t nowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear buckets in the style of HdrHistogram: exact below SUB_BUCKETS,
+// then SUB_BUCKETS / 2 buckets per power of two, which keeps every recorded
+// value within 1/64 of the truth. Histograms are merged after a run.
+class LatencyHistogram
+{
+private:
+    static constexpr int SUB_BITS = 7;
+    static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr uint64_t HALF = SUB_BUCKETS / 2;
+
+    vector<uint64_t> counts = vector<uint64_t>(SUB_BUCKETS + (64 - SUB_BITS) * HALF, 0);
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maxValue = 0;
+
+    static size_t indexOf(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return value;
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS + 1;
+        return SUB_BUCKETS + (shift - 1) * HALF + ((value >> shift) - HALF);
+    }
+
+    // Largest value that lands in the bucket
+    static uint64_t highestIn(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+        size_t k = index - SUB_BUCKETS;
+        int shift = k / HALF + 1;
+        uint64_t top = k % HALF + HALF;
+        return ((top + 1) << shift) - 1;
+    }
+
+public:
+    void record(uint64_t value)
+    {
+        counts[indexOf(value)]++;
+        total++;
+        sum += value;
+        maxValue = max(maxValue, value);
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        maxValue = max(maxValue, other.maxValue);
+    }
+
+    uint64_t count() const
+    {
+        return total;
+    }
+
+    double mean() const
+    {
+        return total ? double(sum) / total : 0;
+    }
+
+    uint64_t highest() const
+    {
+        return maxValue;
+    }
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double p) const
+    {
+        if (!total)
+            return 0;
+        uint64_t rank = max<uint64_t>(1, uint64_t(ceil(p / 100 * total)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return min(highestIn(i), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+// Payload sizes drawn from "fixed:N", "uniform:MIN-MAX" or
+// "lognormal:MEDIAN:SIGMA". Sizes never go below the 8-byte send timestamp.
+class PayloadSizes
+{
+private:
+    string kind;
+    double a = 64, b = 0;
+
+public:
+    explicit PayloadSizes(const string &spec)
+    {
+        size_t colon = spec.find(':');
+        kind = spec.substr(0, colon);
+        string args = colon == string::npos ? "" : spec.substr(colon + 1);
+
+        if (kind == "fixed" && !args.empty())
+            a = stod(args);
+        else if (kind == "uniform" && args.find('-') != string::npos)
+        {
+            a = stod(args.substr(0, args.find('-')));
+            b = stod(args.substr(args.find('-') + 1));
+        }
+        else if (kind == "lognormal" && args.find(':') != string::npos)
+        {
+            a = stod(args.substr(0, args.find(':')));
+            b = stod(args.substr(args.find(':') + 1));
+        }
+        else
+            throw invalid_argument("bad payload spec: " + spec);
+    }
+
+    size_t next(mt19937_64 &rng) const
+    {
+        double size = a;
+        if (kind == "uniform")
+            size = uniform_int_distribution<size_t>(size_t(a), size_t(b))(rng);
+        else if (kind == "lognormal")
+            size = lognormal_distribution<double>(log(a), b)(rng);
+        return max<size_t>(8, size_t(size));
+    }
+};
+
+// Producers push 64-byte messages stamped with their send time; each consumer
+// tails the topic from offset 0 and records push-to-read latency
+static RunResult runPushRead(const TopicOptions &options, int producers, int consumers, int durationMs)
+{
+    QueueTopic topic("bench", chrono::seconds(60), options);
+    atomic<bool> go{false}, done{false};
+    atomic<long long> pushed{0}, delivered{0};
+    vector<vector<uint32_t>> latencies(consumers);
+    vector<thread> workers;
+
+    for (int p = 0; p < producers; p++)
+    {
+        workers.emplace_back([&]()
+                             {
+            string payload(64, 'x');
+            long long count = 0;
+
+            while (!go.load())
+                this_thread::yield();
+
+            while (!done.load(memory_order_relaxed))
+            {
+                int64_t sent = nowNs();
+                memcpy(payload.data(), &sent, sizeof(sent));
+                topic.push({payload});
+                count++;
+            }
+            pushed += count; });
+    }
+
+    for (int c = 0; c < consumers; c++)
+    {
+        workers.emplace_back([&, c]()
+                             {
+            size_t offset = 0;
+            long long count = 0;
+
+            while (!go.load())
+                this_thread::yield();
+
+            while (!done.load(memory_order_relaxed))
+            {
+                MessageBatch batch = topic.read(offset, 256);
+                if (batch.empty())
+                {
+                    this_thread::yield();
+                    continue;
+                }
+
+                int64_t now = nowNs();
+                for (auto &message : batch)
+                {
+                    int64_t sent;
+                    memcpy(&sent, message.content.data(), sizeof(sent));
+                    if (count++ % 16 == 0)
+                        latencies[c].push_back((now - sent) / 1000);
+                }
+            }
+            delivered += count; });
+    }
+
+    auto start = chrono::steady_clock::now();
+    go = true;
+    this_thread::sleep_for(chrono::milliseconds(durationMs));
+    done = true;
+    for (auto &w : workers)
+        w.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<uint32_t> all;
+    for (auto &l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    uint64_t p99 = 0;
+    if (!all.empty())
+    {
+        size_t rank = all.size() * 99 / 100;
+        nth_element(all.begin(), all.begin() + rank, all.end());
+        p99 = all[rank];
+    }
+    return {pushed.load() / secs, delivered.load() / secs, p99};
+}
+
+// Mutex-guarded deque against the lock-free ring on one hot topic
+static void benchRing(const BenchConfig &cfg)
+{
+    vector<pair<string, StorageType>> storages = {{"memory", MEMORY}, {"ring", RING}};
+
+    cout << "storage\tproducers\tconsumers\tpush Mmsg/s\tdelivered Mmsg/s\tp99 us" << endl;
+    for (auto &[name, type] : storages)
+    {
+        TopicOptions options;
+        options.storage = type;
+        for (int producers : {1, 2, 4, 8, 16})
+        {
+            for (int consumers : {1, 4, 16, 64})
+            {
+                RunResult r = runPushRead(options, producers, consumers, cfg.durationMs);
+                cout << name << "\t" << producers << "\t" << consumers << "\t" << fixed << setprecision(2)
+                     << r.pushedPerSec / 1e6 << "\t" << r.deliveredPerSec / 1e6 << "\t" << r.p99Us << endl;
+            }
+        }
+    }
+}
+
+// Keyed producers and one group member per partition; each partition has its
+// own storage and lock, so throughput should track the partition count
+static void benchPartitions(const BenchConfig &cfg)
+{
+    const int producers = 4;
+    cout << "partitions\tpush Mmsg/s\tconsumed Mmsg/s" << endl;
+
+    for (size_t partitions : {1, 2, 4, 8, 16})
+    {
+        MessageQueueService service(chrono::seconds(60));
+        TopicHandle topic = service.createTopic("bench", partitions);
+        for (size_t m = 0; m < partitions; m++)
+            service.joinGroup("group", "bench", "member" + to_string(m));
+
+        atomic<bool> go{false}, done{false};
+        atomic<long long> pushed{0}, consumed{0};
+        vector<thread> workers;
+
+        for (int p = 0; p < producers; p++)
+        {
+            workers.emplace_back([&, p]()
+                                 {
+                mt19937 rng(p + 1);
+                string payload(64, 'x');
+                long long count = 0;
+
+                while (!go.load())
+                    this_thread::yield();
+
+                while (!done.load(memory_order_relaxed))
+                {
+                    service.push(topic, "key" + to_string(rng() % 1024), {payload});
+                    count++;
+                }
+                pushed += count; });
+        }
+
+        for (size_t m = 0; m < partitions; m++)
+        {
+            workers.emplace_back([&, m]()
+                                 {
+                string member = "member" + to_string(m);
+                long long count = 0;
+
+                while (!go.load())
+                    this_thread::yield();
+
+                while (!done.load(memory_order_relaxed))
+                {
+                    auto batches = service.pollGroup("group", member, 256);
+                    if (batches.empty())
+                        this_thread::yield();
+                    for (auto &[partition, batch, lane] : batches)
+                    {
+                        count += batch.size();
+                        service.commitOffset("group", member, partition, batch[batch.size() - 1].offset + 1, lane);
+                    }
+                }
+                consumed += count; });
+        }
+
+        auto start = chrono::steady_clock::now();
+        go = true;
+        this_thread::sleep_for(chrono::milliseconds(cfg.durationMs));
+        done = true;
+        for (auto &w : workers)
+            w.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << partitions << "\t" << fixed << setprecision(2) << pushed.load() / secs / 1e6 << "\t"
+             << consumed.load() / secs / 1e6 << endl;
+    }
+}
+
+// Heap bytes per message and push/read rates for small JSON payloads
+static void benchCompression(const BenchConfig &)
+{
+    const int count = 200000;
+    vector<string> payloads;
+    mt19937 rng(7);
+    for (int i = 0; i < count; i++)
+        payloads.push_back("{\"user\":\"u" + to_string(rng() % 10000) + "\",\"event\":\"" +
+                           (rng() % 2 ? "click" : "view") + "\",\"page\":\"/products/" + to_string(rng() % 500) +
+                           "\",\"ts\":" + to_string(1700000000000ll + i) + "}");
+
+    struct Variant
+    {
+        string name;
+        StorageType storage;
+        CompressionType compression;
+    };
+    vector<Variant> variants = {
+        {"memory", MEMORY, NO_COMPRESSION},
+        {"batched", BATCHED, NO_COMPRESSION},
+        {"batched+lz4", BATCHED, LZ4_COMPRESSION},
+    };
+
+    cout << "storage\tbytes/msg\tpush Mmsg/s\tread Mmsg/s" << endl;
+    for (auto &variant : variants)
+    {
+        TopicOptions options;
+        options.storage = variant.storage;
+        options.compression = variant.compression;
+
+        size_t before = mallinfo2().uordblks;
+        {
+            QueueTopic topic("bench", chrono::hours(1), options);
+
+            auto start = chrono::steady_clock::now();
+            for (auto &payload : payloads)
+                topic.push({payload});
+            double pushSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            double bytesPerMessage = double(mallinfo2().uordblks - before) / count;
+
+            start = chrono::steady_clock::now();
+            size_t offset = 0, read = 0;
+            while (read < size_t(count))
+                read += topic.read(offset, 1000).size();
+            double readSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            cout << variant.name << "\t" << fixed << setprecision(1) << bytesPerMessage << "\t" << setprecision(2)
+                 << count / pushSecs / 1e6 << "\t" << count / readSecs / 1e6 << endl;
+        }
+    }
+}
+
+// Byte-retained ring fed by producers that stay alive: once trimmed and
+// cleaned up, the heap must come back to about the retention limit rather
+// than keep dropped chunks waiting on some thread's reclaim list. Exits
+// non-zero if it does not.
+static void benchRetention(const BenchConfig &cfg)
+{
+    const size_t retentionBytes = 16 << 20, payloadBytes = 256, perProducer = 100000;
+
+    TopicOptions options;
+    options.storage = RING;
+    options.retentionBytes = retentionBytes;
+
+    size_t before = mallinfo2().uordblks;
+    QueueTopic topic("bench", chrono::hours(1), options);
+
+    mutex mtx;
+    condition_variable cv;
+    int finished = 0;
+    bool measured = false;
+    vector<thread> producers;
+    for (int p = 0; p < cfg.producers; p++)
+        producers.emplace_back([&]
+                               {
+            for (size_t i = 0; i < perProducer; i++)
+                topic.push({string(payloadBytes, 'x')});
+            unique_lock<mutex> lock(mtx);
+            finished++;
+            cv.notify_all();
+            cv.wait(lock, [&] { return measured; }); });
+
+    {
+        unique_lock<mutex> lock(mtx);
+        cv.wait(lock, [&]
+                { return finished == cfg.producers; });
+    }
+    for (int i = 0; i < 4; i++)
+        topic.cleanup();
+
+    StorageUsage usage = topic.usage();
+    size_t heap = mallinfo2().uordblks - before;
+    // Each retained message also costs its slot and allocator overhead
+    size_t limit = usage.messages * (sizeof(string) + 64) + retentionBytes * 5 / 4;
+    {
+        lock_guard<mutex> lock(mtx);
+        measured = true;
+    }
+    cv.notify_all();
+    for (auto &producer : producers)
+        producer.join();
+
+    cout << "pushed	retained msgs	retained MB	heap MB	limit MB" << endl;
+    cout << cfg.producers * perProducer << "\t" << usage.messages << "\t" << fixed << setprecision(1)
+         << usage.bytes / 1e6 << "\t" << heap / 1e6 << "\t" << limit / 1e6 << endl;
+    if (usage.bytes > retentionBytes || heap > limit)
+    {
+        cout << "FAIL: memory above retention after cleanup" << endl;
+        exit(1);
+    }
+}
+
+static StorageType storageNamed(const string &name)
+{
+    map<string, StorageType> types = {{"memory", MEMORY}, {"ring", RING}, {"batched", BATCHED}, {"log", SEGMENTED_LOG}};
+    auto it = types.find(name);
+    if (it == types.end())
+        throw invalid_argument("unknown storage: " + name);
+    return it->second;
+}
+
+// Deletes a directory of segment directories, as the "log" storage leaves it
+static void removeLogDir(const string &dir)
+{
+    if (DIR *d = ::opendir(dir.c_str()))
+    {
+        while (dirent *e = ::readdir(d))
+        {
+            string name = e->d_name;
+            if (name == "." || name == "..")
+                continue;
+            string path = dir + "/" + name;
+            if (e->d_type == DT_DIR)
+                removeLogDir(path);
+            else
+                ::unlink(path.c_str());
+        }
+        ::closedir(d);
+    }
+    ::rmdir(dir.c_str());
+}
+
+// The whole service end to end: every producer pushes through a cached handle
+// to topic p % topics, and every consumer tails all partitions of topic
+// c % topics. Latency runs from the send time stamped into the payload to the
+// read; with --rate it runs from the scheduled send time instead, so a
+// stalled producer cannot hide queueing delay.
+static void benchService(const BenchConfig &cfg)
+{
+    PayloadSizes sizes(cfg.payload);
+    TopicOptions options;
+    options.storage = storageNamed(cfg.storage);
+    options.dir = "bench-data-" + to_string(::getpid());
+
+    int consumers = max(cfg.consumers, 0);
+    vector<LatencyHistogram> histograms(consumers);
+    atomic<bool> go{false}, done{false};
+    atomic<long long> pushed{0}, delivered{0}, payloadBytes{0};
+    double secs;
+    StorageUsage retained;
+
+    size_t heapBefore = mallinfo2().uordblks;
+    size_t heapAfter;
+    {
+        MessageQueueService service(chrono::milliseconds(cfg.ttlMs), options);
+        vector<TopicHandle> topics;
+        for (int t = 0; t < max(cfg.topics, 1); t++)
+            topics.push_back(service.createTopic("bench" + to_string(t), max(cfg.partitions, 1)));
+
+        vector<thread> workers;
+        for (int p = 0; p < cfg.producers; p++)
+        {
+            workers.emplace_back([&, p]()
+                                 {
+                const TopicHandle &topic = topics[p % topics.size()];
+                mt19937_64 rng(p + 1);
+                int64_t interval = cfg.rate > 0 ? 1000000000ll / cfg.rate : 0;
+                long long count = 0, bytes = 0;
+
+                while (!go.load())
+                    this_thread::yield();
+
+                int64_t scheduled = nowNs();
+                while (!done.load(memory_order_relaxed))
+                {
+                    int64_t sent = nowNs();
+                    if (interval)
+                    {
+                        if (sent < scheduled)
+                        {
+                            this_thread::yield();
+                            continue;
+                        }
+                        sent = scheduled;
+                        scheduled += interval;
+                    }
+
+                    string payload(sizes.next(rng), 'x');
+                    memcpy(payload.data(), &sent, sizeof(sent));
+                    bytes += payload.size();
+                    service.push(topic, {std::move(payload)});
+                    count++;
+                }
+                pushed += count;
+                payloadBytes += bytes; });
+        }
+
+        for (int c = 0; c < consumers; c++)
+        {
+            workers.emplace_back([&, c]()
+                                 {
+                const TopicHandle &topic = topics[c % topics.size()];
+                vector<size_t> offsets(topic->partitionCount(), 0);
+                LatencyHistogram &histogram = histograms[c];
+                long long count = 0;
+
+                while (!go.load())
+                    this_thread::yield();
+
+                while (!done.load(memory_order_relaxed))
+                {
+                    bool any = false;
+                    for (size_t partition = 0; partition < offsets.size(); partition++)
+                    {
+                        MessageBatch batch = service.readBatch(topic, partition, offsets[partition], 256);
+                        if (batch.empty())
+                            continue;
+
+                        any = true;
+                        int64_t now = nowNs();
+                        for (auto &message : batch)
+                        {
+                            int64_t sent;
+                            memcpy(&sent, message.content.data(), sizeof(sent));
+                            histogram.record(max<int64_t>(now - sent, 0));
+                        }
+                        count += batch.size();
+                    }
+                    if (!any)
+                        this_thread::yield();
+                }
+                delivered += count; });
+        }
+
+        auto start = chrono::steady_clock::now();
+        go = true;
+        this_thread::sleep_for(chrono::milliseconds(cfg.durationMs));
+        done = true;
+        for (auto &w : workers)
+            w.join();
+        secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        for (auto &topic : topics)
+        {
+            StorageUsage used = topic->usage();
+            retained.messages += used.messages;
+            retained.bytes += used.bytes;
+        }
+        heapAfter = mallinfo2().uordblks;
+    }
+    if (options.storage == SEGMENTED_LOG)
+        removeLogDir(options.dir);
+
+    LatencyHistogram latency;
+    for (auto &histogram : histograms)
+        latency.merge(histogram);
+
+    double heapPerMessage = retained.messages ? double(heapAfter - min(heapAfter, heapBefore)) / retained.messages : 0;
+    double storedPerMessage = retained.messages ? double(retained.bytes) / retained.messages : 0;
+    double payloadPerMessage = pushed.load() ? double(payloadBytes.load()) / pushed.load() : 0;
+    auto us = [](uint64_t ns)
+    { return ns / 1000.0; };
+
+    if (cfg.json)
+    {
+        cout << fixed << setprecision(3) << "{\"scenario\":\"service\",\"config\":{"
+             << "\"durationMs\":" << cfg.durationMs << ",\"topics\":" << cfg.topics << ",\"partitions\":"
+             << cfg.partitions << ",\"producers\":" << cfg.producers << ",\"consumers\":" << cfg.consumers
+             << ",\"payload\":\"" << cfg.payload << "\",\"ttlMs\":" << cfg.ttlMs << ",\"storage\":\""
+             << cfg.storage << "\",\"rate\":" << cfg.rate << "},\"results\":{"
+             << "\"pushedPerSec\":" << pushed.load() / secs << ",\"deliveredPerSec\":" << delivered.load() / secs
+             << ",\"latencyUs\":{\"count\":" << latency.count() << ",\"mean\":" << us(latency.mean())
+             << ",\"p50\":" << us(latency.percentile(50)) << ",\"p90\":" << us(latency.percentile(90))
+             << ",\"p99\":" << us(latency.percentile(99)) << ",\"p999\":" << us(latency.percentile(99.9))
+             << ",\"max\":" << us(latency.highest()) << "},\"retainedMessages\":" << retained.messages
+             << ",\"payloadBytesPerMessage\":" << payloadPerMessage
+             << ",\"storedBytesPerMessage\":" << storedPerMessage << ",\"heapBytesPerMessage\":" << heapPerMessage
+             << "}}" << endl;
+        return;
+    }
+
+    cout << fixed << setprecision(2) << "push Mmsg/s\t" << pushed.load() / secs / 1e6 << "\n"
+         << "delivered Mmsg/s\t" << delivered.load() / secs / 1e6 << "\n"
+         << "latency us p50/p90/p99/p99.9/max\t" << us(latency.percentile(50)) << " / "
+         << us(latency.percentile(90)) << " / " << us(latency.percentile(99)) << " / "
+         << us(latency.percentile(99.9)) << " / " << us(latency.highest()) << "\n"
+         << "retained messages\t" << retained.messages << "\n"
+         << setprecision(1) << "payload / stored / heap bytes per msg\t" << payloadPerMessage << " / "
+         << storedPerMessage << " / " << heapPerMessage << endl;
+}
+
+int main(int argc, char **argv)
+{
+    string scenario = argc > 1 ? argv[1] : "ring";
+    BenchConfig cfg;
+
+    map<string, int *> intFlags = {
+        {"durationMs", &cfg.durationMs}, {"topics", &cfg.topics}, {"partitions", &cfg.partitions},
+        {"producers", &cfg.producers}, {"consumers", &cfg.consumers}, {"ttlMs", &cfg.ttlMs}, {"rate", &cfg.rate}};
+    for (int i = 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0)
+        {
+            cfg.durationMs = stoi(arg);
+            continue;
+        }
+
+        size_t eq = arg.find('=');
+        string key = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (intFlags.count(key))
+            *intFlags[key] = stoi(value);
+        else if (key == "payload")
+            cfg.payload = value;
+        else if (key == "storage")
+            cfg.storage = value;
+        else if (key == "json")
+            cfg.json = true;
+        else
+        {
+            cout << "unknown option: " << arg << endl;
+            return 1;
+        }
+    }
+
+    map<string, function<void(const BenchConfig &)>> scenarios = {
+        {"ring", benchRing},
+        {"partitions", benchPartitions},
+        {"compression", benchCompression},
+        {"retention", benchRetention},
+        {"service", benchService},
+    };
+
+    auto it = scenarios.find(scenario);
+    if (it == scenarios.end())
+    {
+        cout << "unknown scenario: " << scenario << endl;
+        return 1;
+    }
+    it->second(cfg);
+}
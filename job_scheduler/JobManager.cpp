@@ -0,0 +1,231 @@
+#include "bits/stdc++.h"
+#include "ThreadPool.cpp"
+#include "TimingWheel.cpp"
+
+using namespace std;
+
+#pragma once
+
+struct ScheduledJob
+{
+    shared_ptr<Job> job;
+    chrono::steady_clock::time_point nextExecution;
+    int priority;
+    bool isRecurring = false;
+    int intervalS = 0;
+};
+
+class JobManager
+{
+private:
+    using Clock = chrono::steady_clock;
+
+    // A submitted job. Scheduled on the wheel while it waits, and kept
+    // alive by the wheel's reference meanwhile.
+    struct Entry : TimerNode
+    {
+        // Queued on the pool as a borrowed Job*, so a dispatch allocates
+        // nothing. While queued or running it keeps its entry alive.
+        struct Runner : Job
+        {
+            Entry *entry;
+            shared_ptr<Entry> keepAlive;
+            atomic<bool> busy{false};
+
+            void execute() override
+            {
+                entry->schedule->job->execute();
+                shared_ptr<Entry> self = std::move(keepAlive);
+                busy.store(false, memory_order_release);
+            }
+        };
+
+        shared_ptr<ScheduledJob> schedule;
+        shared_ptr<Entry> waiting; // set while on the wheel
+        Runner runner;
+
+        Entry()
+        {
+            runner.entry = this;
+        }
+    };
+
+    struct ReadyCmp
+    {
+        bool operator()(const shared_ptr<Entry> &a, const shared_ptr<Entry> &b)
+        {
+            return a->schedule->priority < b->schedule->priority; // Highest priority first
+        }
+    };
+
+    // Delayed jobs, at millisecond resolution
+    TimingWheel wheel;
+    priority_queue<shared_ptr<Entry>, vector<shared_ptr<Entry>>, ReadyCmp> readyPq;
+
+    shared_ptr<ThreadPool> pool;
+    thread schedulerThread;
+    mutex mtx;
+    condition_variable cv;
+    bool stop = false;
+
+    // Callers hold mtx. The wheel rounds up, so a job never runs before
+    // its nextExecution.
+    void arm(const shared_ptr<Entry> &entry)
+    {
+        entry->waiting = entry;
+        wheel.schedule(entry.get(), entry->schedule->nextExecution);
+    }
+
+    bool disarm(Entry &entry)
+    {
+        if (!entry.scheduled())
+            return false;
+        wheel.cancel(&entry);
+        entry.waiting.reset();
+        return true;
+    }
+
+    void dispatch(const shared_ptr<Entry> &entry)
+    {
+        Entry::Runner &runner = entry->runner;
+        if (runner.busy.load(memory_order_acquire))
+        {
+            // A recurring job whose last run has not finished; rare enough
+            // to take the allocating path
+            pool->push(entry->schedule->job);
+            return;
+        }
+        runner.busy.store(true, memory_order_relaxed);
+        runner.keepAlive = entry;
+        pool->push(&runner);
+    }
+
+    bool cancel(Entry &entry)
+    {
+        lock_guard<mutex> lock(mtx);
+        return disarm(entry);
+    }
+
+    void reschedule(const shared_ptr<Entry> &entry, Clock::time_point at)
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            disarm(*entry);
+            entry->schedule->nextExecution = at;
+            arm(entry);
+        }
+        cv.notify_one();
+    }
+
+    bool scheduled(const Entry &entry)
+    {
+        lock_guard<mutex> lock(mtx);
+        return entry.scheduled();
+    }
+
+public:
+    // Returned by submit(); must not outlive its JobManager
+    class Handle
+    {
+    private:
+        friend class JobManager;
+        JobManager *manager = nullptr;
+        shared_ptr<Entry> entry;
+
+        Handle(JobManager *manager, shared_ptr<Entry> entry) : manager(manager), entry(std::move(entry)) {}
+
+    public:
+        Handle() = default;
+
+        // Keeps the job from running again. False if it was not waiting to
+        // run (a one-shot job that already ran, or cancelled before). A run
+        // already handed to the pool is not interrupted.
+        bool cancel()
+        {
+            return entry && manager->cancel(*entry);
+        }
+
+        // Moves the next run to at; also re-arms a job that already ran or
+        // was cancelled
+        void reschedule(Clock::time_point at)
+        {
+            if (entry)
+                manager->reschedule(entry, at);
+        }
+
+        bool scheduled() const
+        {
+            return entry && manager->scheduled(*entry);
+        }
+
+        const shared_ptr<ScheduledJob> &job() const
+        {
+            static const shared_ptr<ScheduledJob> none;
+            return entry ? entry->schedule : none;
+        }
+    };
+
+    JobManager(shared_ptr<ThreadPool> pool) : pool(pool)
+    {
+        schedulerThread = thread([this]()
+                                 {
+            vector<shared_ptr<Entry>> due;
+            while (true) {
+                unique_lock<mutex> lock(mtx);
+                
+                if (stop && wheel.size() == 0) break;
+
+                if (wheel.size() == 0) {
+                    cv.wait(lock, [this] { return stop || wheel.size() > 0; });
+                    if (stop && wheel.size() == 0) break;
+                }
+                else{
+                    cv.wait_until(lock, wheel.nextExpiry());
+                }
+
+                auto now = Clock::now();
+                wheel.advance(now, [&](TimerNode *node)
+                              { due.push_back(std::move(static_cast<Entry *>(node)->waiting)); });
+
+                for (auto &entry : due) {
+                    readyPq.push(entry);
+
+                    // Once stopping, recurring jobs run out instead of keeping the wheel busy
+                    if (entry->schedule->isRecurring && !stop) {
+                        entry->schedule->nextExecution = now + chrono::seconds(entry->schedule->intervalS);
+                        arm(entry);
+                    }
+                }
+                due.clear();
+
+                // Push everything from readyPq to the ThreadPool
+                while (!readyPq.empty()) {
+                    dispatch(readyPq.top());
+                    readyPq.pop();
+                }
+            } });
+    }
+
+    Handle submit(shared_ptr<ScheduledJob> jobSchedule)
+    {
+        auto entry = make_shared<Entry>();
+        entry->schedule = std::move(jobSchedule);
+        {
+            lock_guard<mutex> lock(mtx);
+            arm(entry);
+        }
+        cv.notify_one(); // Wake up scheduler to re-evaluate wait time
+        return Handle(this, entry);
+    }
+
+    ~JobManager()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        if (schedulerThread.joinable())
+            schedulerThread.join();
+    }
+};
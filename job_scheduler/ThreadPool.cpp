@@ -0,0 +1,326 @@
+#include "bits/stdc++.h"
+#include "WorkStealingDeque.cpp"
+
+using namespace std;
+
+#pragma once
+
+class Job
+{
+public:
+    virtual void execute() = 0;
+    virtual ~Job() = default;
+};
+
+// Work-stealing pool. Every worker has its own Chase-Lev deque: a job pushed
+// from inside a job goes there and runs LIFO on the same worker, and idle
+// workers steal from the other end. Pushes from outside the pool land in a
+// shared injection queue that workers drain in small batches.
+//
+// An idle worker spins for a while, rescanning for work, before it parks.
+// The spin budget adapts: it grows when spinning finds work and shrinks when
+// the worker ends up parking anyway.
+class ThreadPool
+{
+private:
+    // Queued jobs are raw pointers, so dispatch costs no refcount traffic.
+    // The low bit marks a job the pool owns and deletes after running it.
+    using Task = uintptr_t;
+
+    static Task owned(Job *job)
+    {
+        return reinterpret_cast<Task>(job) | 1;
+    }
+
+    static Task borrowed(Job *job)
+    {
+        return reinterpret_cast<Task>(job);
+    }
+
+    static void run(Task task)
+    {
+        Job *job = reinterpret_cast<Job *>(task & ~Task(1));
+        job->execute();
+        if (task & 1)
+            delete job;
+    }
+
+    // For a task pushed after shutdown began
+    static void discard(Task task)
+    {
+        if (task & 1)
+            delete reinterpret_cast<Job *>(task & ~Task(1));
+    }
+
+    // Lets a shared_ptr job be queued like any other
+    class SharedJob : public Job
+    {
+    private:
+        shared_ptr<Job> job;
+
+    public:
+        explicit SharedJob(shared_ptr<Job> job) : job(std::move(job)) {}
+
+        void execute() override
+        {
+            job->execute();
+        }
+    };
+
+    static constexpr int MIN_SPINS = 16;
+    static constexpr int MAX_SPINS = 4096;
+    static constexpr size_t INJECT_BATCH = 32;
+
+    struct alignas(64) Worker
+    {
+        WorkStealingDeque<Task> deque;
+        uint64_t rng;
+        int spinLimit = 256;
+    };
+
+    vector<unique_ptr<Worker>> workerState;
+    vector<thread> workers;
+
+    mutex injectMtx;
+    deque<Task> injected;
+    atomic<size_t> injectedCount{0};
+
+    mutex parkMtx;
+    condition_variable parkCv;
+    atomic<int> sleepers{0};
+
+    // Shutdown closes the pool to new pushes, waits out the outside pushes
+    // already past that check, and only then lets idle workers exit, so a
+    // job is either refused or run, never left in the injection queue
+    atomic<bool> closed{false};
+    atomic<int> pushers{0};
+    atomic<bool> stopping{false};
+
+    // The worker running on this thread, if it belongs to this pool
+    static inline thread_local ThreadPool *currentPool = nullptr;
+    static inline thread_local Worker *currentWorker = nullptr;
+
+    static void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        this_thread::yield();
+#endif
+    }
+
+    // Moves a batch from the injection queue to the worker's deque and
+    // returns one job of it to run
+    Task takeInjected(Worker &self)
+    {
+        if (injectedCount.load(memory_order_relaxed) == 0)
+            return 0;
+
+        lock_guard<mutex> lock(injectMtx);
+        if (injected.empty())
+            return 0;
+
+        // An even share per worker, so one worker does not hoard a burst
+        size_t share = min({INJECT_BATCH, injected.size(), injected.size() / workerState.size() + 1});
+        Task task = injected.front();
+        injected.pop_front();
+        for (size_t i = 1; i < share; i++)
+        {
+            self.deque.push(injected.front());
+            injected.pop_front();
+        }
+        injectedCount.store(injected.size(), memory_order_relaxed);
+        return task;
+    }
+
+    // One pass over the other workers, starting at a random one
+    Task stealFromOthers(Worker &self)
+    {
+        size_t n = workerState.size();
+        self.rng ^= self.rng << 13;
+        self.rng ^= self.rng >> 7;
+        self.rng ^= self.rng << 17;
+        size_t start = self.rng % n;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Worker &victim = *workerState[(start + i) % n];
+            if (&victim == &self)
+                continue;
+            if (Task task = victim.deque.steal())
+                return task;
+        }
+        return 0;
+    }
+
+    Task findWork(Worker &self)
+    {
+        if (Task task = self.deque.take())
+            return task;
+        if (Task task = takeInjected(self))
+            return task;
+        return stealFromOthers(self);
+    }
+
+    bool hasWork() const
+    {
+        if (injectedCount.load(memory_order_relaxed) > 0)
+            return true;
+        for (auto &worker : workerState)
+            if (!worker->deque.empty())
+                return true;
+        return false;
+    }
+
+    // Wakes a parked worker, if any. The fence pairs with the one in park():
+    // either the pusher sees the sleeper or the sleeper sees the new job.
+    void wakeOne()
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sleepers.load(memory_order_relaxed) == 0)
+            return;
+        lock_guard<mutex> lock(parkMtx);
+        parkCv.notify_one();
+    }
+
+    // Returns false once the pool is stopping and out of work
+    bool park()
+    {
+        unique_lock<mutex> lock(parkMtx);
+        sleepers.fetch_add(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!hasWork())
+        {
+            if (stopping.load())
+            {
+                sleepers.fetch_sub(1, memory_order_relaxed);
+                return false;
+            }
+            parkCv.wait(lock);
+        }
+        sleepers.fetch_sub(1, memory_order_relaxed);
+        return true;
+    }
+
+    void workerLoop(Worker &self)
+    {
+        currentPool = this;
+        currentWorker = &self;
+
+        while (true)
+        {
+            if (Task task = findWork(self))
+            {
+                run(task);
+                continue;
+            }
+
+            Task found = 0;
+            for (int spin = 0; spin < self.spinLimit && !found; spin++)
+            {
+                cpuRelax();
+                found = findWork(self);
+            }
+
+            if (found)
+            {
+                self.spinLimit = min(self.spinLimit * 2, MAX_SPINS);
+                run(found);
+                continue;
+            }
+
+            self.spinLimit = max(self.spinLimit / 2, MIN_SPINS);
+            if (!park())
+                return;
+        }
+    }
+
+    void enqueue(Task task)
+    {
+        if (currentPool == this)
+        {
+            // This worker cannot exit while its deque holds the task
+            if (closed.load(memory_order_relaxed))
+                return discard(task);
+            currentWorker->deque.push(task);
+            // The pushing worker will get to it anyway, so a missed wake-up
+            // only costs parallelism; skip the fence
+            if (sleepers.load(memory_order_relaxed) > 0)
+                wakeOne();
+            return;
+        }
+
+        // seq_cst, paired with the destructor's store to closed then load
+        // of pushers: one of the two sees the other
+        pushers.fetch_add(1);
+        if (closed.load())
+        {
+            pushers.fetch_sub(1, memory_order_release);
+            return discard(task);
+        }
+        {
+            lock_guard<mutex> lock(injectMtx);
+            injected.push_back(task);
+            injectedCount.store(injected.size(), memory_order_relaxed);
+        }
+        wakeOne();
+        pushers.fetch_sub(1, memory_order_release);
+    }
+
+public:
+    ThreadPool(int n)
+    {
+        n = max(n, 1);
+        for (int i = 0; i < n; i++)
+        {
+            workerState.push_back(make_unique<Worker>());
+            workerState.back()->rng = 0x9e3779b97f4a7c15ull * (i + 1);
+        }
+        for (int i = 0; i < n; i++)
+            workers.emplace_back([this, i]()
+                                 { workerLoop(*workerState[i]); });
+    }
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    // The caller keeps the job alive until it has run. Jobs pushed once the
+    // destructor has started are dropped.
+    void push(Job *job)
+    {
+        enqueue(borrowed(job));
+    }
+
+    template <typename T>
+    void push(unique_ptr<T> job)
+    {
+        enqueue(owned(job.release()));
+    }
+
+    // Costs an extra allocation; prefer the other overloads on hot paths
+    template <typename T>
+    void push(shared_ptr<T> job)
+    {
+        if (closed.load(memory_order_relaxed))
+            return;
+        enqueue(owned(new SharedJob(std::move(job))));
+    }
+
+    // Runs every job already queued, then joins the workers
+    ~ThreadPool()
+    {
+        closed.store(true);
+        while (pushers.load(memory_order_acquire) > 0)
+            this_thread::yield();
+        {
+            lock_guard<mutex> lock(parkMtx);
+            stopping = true;
+        }
+        parkCv.notify_all();
+        for (auto &t : workers)
+            if (t.joinable())
+                t.join();
+    }
+};
@@ -0,0 +1,121 @@
+#include "bits/stdc++.h"
+
+using namespace std;
+
+#pragma once
+
+// Chase-Lev deque (the C11 version by Le, Pop, Cohen and Zappa Nardelli).
+// The owning worker pushes and takes at the bottom, LIFO; any other thread
+// steals the oldest item from the top. Only the last item is ever contended.
+// T must be a pointer-sized value with a null "empty" state.
+template <typename T>
+class WorkStealingDeque
+{
+private:
+    struct Array
+    {
+        const int64_t capacity; // a power of two
+        unique_ptr<atomic<T>[]> slots;
+
+        explicit Array(int64_t capacity) : capacity(capacity), slots(new atomic<T>[capacity]) {}
+
+        T get(int64_t i) const
+        {
+            return slots[i & (capacity - 1)].load(memory_order_relaxed);
+        }
+
+        void put(int64_t i, T item)
+        {
+            slots[i & (capacity - 1)].store(item, memory_order_relaxed);
+        }
+    };
+
+    alignas(64) atomic<int64_t> top{0};
+    alignas(64) atomic<int64_t> bottom{0};
+    atomic<Array *> array;
+
+    // A stealer may still be reading an outgrown array, so they are only
+    // freed with the deque; each is half the size of the next
+    vector<unique_ptr<Array>> arrays;
+
+    Array *grow(Array *old, int64_t t, int64_t b)
+    {
+        arrays.push_back(make_unique<Array>(old->capacity * 2));
+        Array *bigger = arrays.back().get();
+        for (int64_t i = t; i < b; i++)
+            bigger->put(i, old->get(i));
+        array.store(bigger, memory_order_release);
+        return bigger;
+    }
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024)
+    {
+        arrays.push_back(make_unique<Array>(capacity));
+        array.store(arrays.back().get(), memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only
+    void push(T item)
+    {
+        int64_t b = bottom.load(memory_order_relaxed);
+        int64_t t = top.load(memory_order_acquire);
+        Array *a = array.load(memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow(a, t, b);
+        a->put(b, item);
+        // Publishes the item (and whatever it points to) to stealers
+        bottom.store(b + 1, memory_order_release);
+    }
+
+    // Owner only. Null if empty or a thief got the last item.
+    T take()
+    {
+        int64_t b = bottom.load(memory_order_relaxed) - 1;
+        Array *a = array.load(memory_order_relaxed);
+        bottom.store(b, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        int64_t t = top.load(memory_order_relaxed);
+
+        if (t > b)
+        {
+            bottom.store(b + 1, memory_order_relaxed);
+            return T();
+        }
+
+        T item = a->get(b);
+        if (t == b)
+        {
+            // Last item: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+                item = T();
+            bottom.store(b + 1, memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread. Null if empty or another thread won the race.
+    T steal()
+    {
+        int64_t t = top.load(memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        int64_t b = bottom.load(memory_order_acquire);
+        if (t >= b)
+            return T();
+
+        Array *a = array.load(memory_order_acquire);
+        T item = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+            return T();
+        return item;
+    }
+
+    // A hint; exact only when no other thread is touching the deque
+    bool empty() const
+    {
+        return bottom.load(memory_order_relaxed) <= top.load(memory_order_relaxed);
+    }
+};
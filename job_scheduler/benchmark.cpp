@@ -0,0 +1,209 @@
+#include "bits/stdc++.h"
+#include "ThreadPool.cpp"
+#include "TimingWheel.cpp"
+
+using namespace std;
+
+// Build: g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+// Usage: ./benchmark [jobs]
+//
+// Dispatch overhead of trivial jobs, in nanoseconds of wall time per job.
+// "external" pushes every job from the main thread (the injection queue);
+// "shared" does the same through the shared_ptr overload, which allocates a
+// wrapper per push (JobManager only takes it for overlapping recurring runs);
+// "fan-out" pushes one root job that splits into children from inside the
+// pool (worker deques and stealing). The single-mutex pool the work-stealing
+// one replaced is kept here as the baseline.
+//
+// The timer section schedules the same number of timers, spread over a
+// minute at millisecond resolution, cancels every other one and expires
+// the rest: once with the timing wheel JobManager uses, once with the
+// binary heap it replaced (which can only cancel lazily, by skipping).
+
+class MutexPool
+{
+private:
+    vector<thread> workers;
+    queue<shared_ptr<Job>> tasks;
+    mutex mtx;
+    condition_variable cv;
+    bool stopping = false;
+
+public:
+    MutexPool(int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            workers.emplace_back([this]()
+                                 {
+                while (true) {
+                    shared_ptr<Job> job;
+                    {
+                        unique_lock<mutex> lock(mtx);
+                        cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                        if (stopping && tasks.empty()) return;
+                        job = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    if (job) job->execute();
+                } });
+        }
+    }
+
+    void push(shared_ptr<Job> job)
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.push(std::move(job));
+        }
+        cv.notify_one();
+    }
+
+    ~MutexPool()
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+};
+
+static atomic<long long> remaining{0};
+
+class CountJob : public Job
+{
+public:
+    void execute() override
+    {
+        remaining.fetch_sub(1, memory_order_relaxed);
+    }
+};
+
+// Hands half of its count to a new job until one is left; a tree started
+// with count N runs exactly N jobs
+class FanOutJob : public Job
+{
+private:
+    ThreadPool &pool;
+    long long count;
+
+public:
+    FanOutJob(ThreadPool &pool, long long count) : pool(pool), count(count) {}
+
+    void execute() override
+    {
+        while (count > 1)
+        {
+            long long half = count / 2;
+            pool.push(make_unique<FanOutJob>(pool, half));
+            count -= half;
+        }
+        remaining.fetch_sub(1, memory_order_relaxed);
+    }
+};
+
+static void waitForAll()
+{
+    while (remaining.load(memory_order_relaxed) > 0)
+        this_thread::yield();
+}
+
+template <typename F>
+static double nsPerJob(long long jobs, F submit)
+{
+    remaining = jobs;
+    auto start = chrono::steady_clock::now();
+    submit();
+    waitForAll();
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / jobs;
+}
+
+// Deadlines in ms; returns ns per scheduled timer
+static double wheelNsPerTimer(const vector<int64_t> &deadlines)
+{
+    auto start = chrono::steady_clock::now();
+    TimingWheel wheel;
+    vector<TimerNode> nodes(deadlines.size());
+    for (size_t i = 0; i < deadlines.size(); i++)
+        wheel.schedule(&nodes[i], start + chrono::milliseconds(deadlines[i]));
+    for (size_t i = 0; i < deadlines.size(); i += 2)
+        wheel.cancel(&nodes[i]);
+
+    size_t fired = 0;
+    for (int64_t tick = 0; wheel.size(); tick++)
+        wheel.advance(start + chrono::milliseconds(tick), [&](TimerNode *)
+                      { fired++; });
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    return fired ? ns / deadlines.size() : 0;
+}
+
+static double heapNsPerTimer(const vector<int64_t> &deadlines)
+{
+    auto start = chrono::steady_clock::now();
+    priority_queue<pair<int64_t, size_t>, vector<pair<int64_t, size_t>>, greater<>> heap;
+    for (size_t i = 0; i < deadlines.size(); i++)
+        heap.emplace(deadlines[i], i);
+    vector<bool> cancelled(deadlines.size());
+    for (size_t i = 0; i < deadlines.size(); i += 2)
+        cancelled[i] = true;
+
+    size_t fired = 0;
+    for (int64_t tick = 0; !heap.empty(); tick++)
+        while (!heap.empty() && heap.top().first <= tick)
+        {
+            fired += !cancelled[heap.top().second];
+            heap.pop();
+        }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    return fired ? ns / deadlines.size() : 0;
+}
+
+int main(int argc, char **argv)
+{
+    long long jobs = argc > 1 ? stoll(argv[1]) : 200000;
+    CountJob job;
+    auto shared = make_shared<CountJob>();
+
+    cout << "workers\tmutex ns/job\texternal ns/job\tshared ns/job\tfan-out ns/job" << endl;
+    for (int workers : {1, 2, 4, 8, 16, 32, 64})
+    {
+        double mutexNs;
+        {
+            MutexPool pool(workers);
+            mutexNs = nsPerJob(jobs, [&]()
+                               {
+                for (long long i = 0; i < jobs; i++)
+                    pool.push(shared); });
+        }
+
+        double externalNs, sharedNs, fanOutNs;
+        {
+            ThreadPool pool(workers);
+            externalNs = nsPerJob(jobs, [&]()
+                                  {
+                for (long long i = 0; i < jobs; i++)
+                    pool.push(&job); });
+            sharedNs = nsPerJob(jobs, [&]()
+                                {
+                for (long long i = 0; i < jobs; i++)
+                    pool.push(shared); });
+            fanOutNs = nsPerJob(jobs, [&]()
+                                { pool.push(make_unique<FanOutJob>(pool, jobs)); });
+        }
+
+        cout << workers << "\t" << fixed << setprecision(1) << mutexNs << "\t" << externalNs << "\t" << sharedNs << "\t"
+             << fanOutNs << endl;
+    }
+
+    mt19937_64 rng(42);
+    vector<int64_t> deadlines(jobs);
+    for (auto &deadline : deadlines)
+        deadline = 1 + rng() % 60000;
+
+    cout << endl
+         << "timers\twheel ns/timer\theap ns/timer" << endl;
+    cout << jobs << "\t" << wheelNsPerTimer(deadlines) << "\t" << heapNsPerTimer(deadlines) << endl;
+}